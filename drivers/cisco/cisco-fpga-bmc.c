@@ -13,22 +13,76 @@
 #include <linux/device.h>
 #include <linux/slab.h>
 #include <linux/regmap.h>
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
+#include <linux/sort.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <asm/unaligned.h>
 
 #include "cisco/fpga.h"
+#include "cisco/hdr.h"
 #include "cisco/mfd.h"
+#include "cisco/reg_access.h"
+#include "cisco/reg_trace.h"
+#include "cisco/util.h"
 
 #define DRIVER_NAME	"cisco-fpga-bmc"
 #define DRIVER_VERSION	"1.0"
 
+#define BMC_BURST_INFO_VER	7	/* info_rom major version */
+#define BMC_BURST_MAX		256	/* bytes per transaction */
+#define BMC_POSTED_MAX		64	/* queued registers */
+
 static int m_mfd_debug;
 module_param(m_mfd_debug, int, 0444);
 MODULE_PARM_DESC(m_mfd_debug, "MFD debug level. 0=none");
 
+static bool m_shared_regmap;
+module_param(m_shared_regmap, bool, 0444);
+MODULE_PARM_DESC(m_shared_regmap, "Give cells windows on one shared regmap");
+
+static int m_burst = 1;
+module_param(m_burst, int, 0444);
+MODULE_PARM_DESC(m_burst, "Auto-increment burst access. 0=off, 1=if supported");
+
+static bool m_latch_cache = true;
+module_param(m_latch_cache, bool, 0444);
+MODULE_PARM_DESC(m_latch_cache, "Skip the address phase when the address is latched already");
+
+static bool m_posted;
+module_param(m_posted, bool, 0444);
+MODULE_PARM_DESC(m_posted, "Post cell writes by default");
+
+static unsigned int m_posted_latency_us = 1000;
+module_param(m_posted_latency_us, uint, 0444);
+MODULE_PARM_DESC(m_posted_latency_us, "Default delay before posted writes are flushed");
+
+/*
+ * How the BMC slave is accessed, and the register address it has
+ * latched; shared by the parent and all cells, and protected by the
+ * root adapter lock.
+ */
+struct bmc_access {
+	u32 latch;
+	bool latch_valid;
+	bool latch_known;	/* how the slave moves it was seen at probe */
+	bool autoinc;
+	bool burst;
+	bool combined;
+};
+
 /*
  * Passed to regmap callbacks in child
  */
 struct bmc_regmap {
 	struct i2c_client *i2c;
+	struct device *dev;
+	struct cisco_fpga_mfd *mfd;	/* NULL for the parent's own */
+	struct bmc_access *access;
+	struct bmc_posted *posted;	/* cells only */
+	struct mutex lock;		/* regmap lock of a cell */
+	unsigned int accesses;		/* ... made while it is held */
 	u32 base;
 };
 
@@ -38,93 +92,553 @@ struct bmc_regmap {
 struct bmc_mfd {
 	struct cisco_fpga_mfd mfd;
 	struct bmc_regmap r;
+	struct bmc_access access;
 };
 
+/*
+ * The BMC slave latches a register address written to addr + 1 and
+ * moves data through addr + 5.  From BMC_BURST_INFO_VER of the info_rom
+ * header on, it also increments the latched address after every dword,
+ * so a run of registers moves in one data transfer.
+ *
+ * Where the adapter allows, the address and data phases go out as one
+ * combined transfer with a repeated start.  The address phase is left
+ * out when the slave has that address latched already, as when polling
+ * a register, or reading on where a burst stopped.  Another master on
+ * the bus moving the latch would defeat this; use m_latch_cache=0 then.
+ *
+ * Called with the root adapter lock held.
+ */
 static int
-_bmc_read(void *context, unsigned int reg, unsigned int *val)
+__bmc_xfer(struct bmc_regmap *bmc, u32 reg, u8 *data, size_t len, bool rd)
 {
-	struct bmc_regmap *bmc = (typeof(bmc))context;
 	struct i2c_client *i2c = bmc->i2c;
 	u8 buf[4];
-	struct i2c_msg msg = {
-		.addr	= i2c->addr + 1,
-		.flags	= 0,
-		.len	= 4,
-		.buf	= buf,
+	struct i2c_msg msg[] = {
+		{
+			.addr	= i2c->addr + 1,
+			.flags	= 0,
+			.len	= sizeof(buf),
+			.buf	= buf,
+		},
+		{
+			.addr	= i2c->addr + 5,
+			.flags	= rd ? I2C_M_RD : 0,
+			.len	= len,
+			.buf	= data,
+		},
 	};
-	int ret, err = 0;
-
-	reg += bmc->base;
+	struct bmc_access *a = bmc->access;
+	int i, first = 0, err = 0;
 
-	buf[0] = reg & 0xff;
-	buf[1] = (reg >> 8) & 0xff;
-	buf[2] = (reg >> 16) & 0xff;
-	buf[3] = (reg >> 24) & 0xff;
+	put_unaligned_le32(reg, buf);
 
-	i2c_lock_bus(i2c->adapter, I2C_LOCK_ROOT_ADAPTER);
-	ret = __i2c_transfer(i2c->adapter, &msg, 1);
-	if (ret < 1) {
-		err = -EIO;
-	} else {
-		msg.flags = I2C_M_RD;
-		msg.addr = i2c->addr + 5;
-		ret = __i2c_transfer(i2c->adapter, &msg, 1);
-		if (ret < 1)
+	if (m_latch_cache && a->latch_known && a->latch_valid &&
+	    (a->latch == reg))
+		first = 1;
+	if (a->combined) {
+		if (__i2c_transfer(i2c->adapter, &msg[first],
+				   ARRAY_SIZE(msg) - first) != ARRAY_SIZE(msg) - first)
 			err = -EIO;
-		else
-			*val = buf[0] | (buf[1] << 8) | (buf[2] << 16) | (buf[3] << 24);
+	} else {
+		for (i = first; !err && (i < ARRAY_SIZE(msg)); ++i)
+			if (__i2c_transfer(i2c->adapter, &msg[i], 1) != 1)
+				err = -EIO;
 	}
-	i2c_unlock_bus(i2c->adapter, I2C_LOCK_ROOT_ADAPTER);
+	/* after an error the latch is unknown */
+	a->latch_valid = !err;
+	a->latch = a->autoinc ? reg + len : reg;
 	return err;
 }
 
+/*
+ * Without auto-increment each dword is a transaction of its own.  The
+ * access mode is read under the lock, as a rescan may change it.
+ */
 static int
-_bmc_write(void *context, unsigned int reg, unsigned int val)
+_bmc_xfer(struct bmc_regmap *bmc, u32 reg, u8 *data, size_t len, bool rd)
+{
+	struct i2c_adapter *adap = bmc->i2c->adapter;
+	size_t i, step;
+	int err = 0;
+
+	i2c_lock_bus(adap, I2C_LOCK_ROOT_ADAPTER);
+	step = bmc->access->burst ? len : 4;
+	for (i = 0; !err && (i < len); i += step)
+		err = __bmc_xfer(bmc, reg + i, &data[i], min(step, len - i), rd);
+	i2c_unlock_bus(adap, I2C_LOCK_ROOT_ADAPTER);
+	return err;
+}
+
+static int
+_bmc_read(void *context, unsigned int reg, unsigned int *val)
 {
 	struct bmc_regmap *bmc = (typeof(bmc))context;
-	struct i2c_client *i2c = bmc->i2c;
 	u8 buf[4];
-	struct i2c_msg msg = {
-		.addr	= i2c->addr + 1,
-		.flags	= 0,
-		.len	= 4,
-		.buf	= buf,
-	};
-	int ret, err = 0;
-
-	reg += bmc->base;
-	buf[0] = reg & 0xff;
-	buf[1] = (reg >> 8) & 0xff;
-	buf[2] = (reg >> 16) & 0xff;
-	buf[3] = (reg >> 24) & 0xff;
-
-	i2c_lock_bus(i2c->adapter, I2C_LOCK_ROOT_ADAPTER);
-	ret = __i2c_transfer(i2c->adapter, &msg, 1);
-	if (ret < 1) {
-		err = -EIO;
+	int err;
+
+	if (cisco_fpga_mfd_link_lost(bmc->mfd))
+		return -ENODEV;
+
+	err = _bmc_xfer(bmc, reg + bmc->base, buf, sizeof(buf), true);
+	if (!err)
+		*val = get_unaligned_le32(buf);
+	reg_trace_access(bmc->dev, REG_TRACE_OP_READ,
+			 (const void __iomem *)(uintptr_t)(reg + bmc->base),
+			 err ? 0 : *val, err);
+	if (!err)
+		err = cisco_fpga_mfd_link_check(bmc->mfd, bmc->dev, reg, *val,
+						_bmc_read, bmc);
+	return err;
+}
+
+/*
+ * Writes a run of registers; data is the little endian register address
+ * followed by the little endian values.
+ */
+static int
+_bmc_write_run(struct bmc_regmap *bmc, const void *data, size_t count)
+{
+	u32 reg = get_unaligned_le32(data);
+	u8 *v = (u8 *)data + 4;
+	size_t i, len = count - 4;
+	int err;
+
+	if (cisco_fpga_mfd_link_lost(bmc->mfd))
+		return -ENODEV;
+
+	/* i2c does not modify the buffer of a write */
+	err = _bmc_xfer(bmc, reg + bmc->base, v, len, false);
+	for (i = 0; i < len; i += 4)
+		reg_trace_access(bmc->dev, REG_TRACE_OP_WRITE,
+				 (const void __iomem *)(uintptr_t)(reg + bmc->base + i),
+				 get_unaligned_le32(&v[i]), err);
+	return err;
+}
+
+/*
+ * Posted writes.  With posting enabled for a cell, its writes are queued
+ * and return at once.  A write to a register already queued replaces the
+ * queued value.  The queue is written out, sorted by register with
+ * contiguous registers merged into bursts, latency_us after the first
+ * queued write, when it holds depth registers, and before any read that
+ * overlaps a queued register.
+ *
+ * Writes to different registers may thus reach the FPGA in another
+ * order than they were made; only enable posting for cells whose
+ * writes do not depend on one another, such as LEDs.  Errors of posted
+ * writes are only counted and logged.
+ *
+ * Only a write made on its own is posted.  Once the regmap lock is held
+ * across several accesses, as by regmap_update_bits(), the batch file
+ * or the u64 helpers, the queue is written out and the rest go straight
+ * to the FPGA, in order and before the lock is released.
+ */
+struct bmc_posted_reg {
+	u32 reg;
+	u32 val;
+};
+
+struct bmc_posted {
+	struct bmc_regmap *bmc;
+	struct mutex lock;
+	struct delayed_work work;
+	struct dentry *file;
+	bool enabled;
+	u32 latency_us;
+	u32 depth;
+	u32 n;
+	struct bmc_posted_reg q[BMC_POSTED_MAX];
+
+	u64 writes;	/* registers written by the cell */
+	u64 coalesced;	/* ... replacing a queued value */
+	u64 xfers;	/* transactions on the bus */
+	u64 flushes;
+	u64 read_flushes;
+	u64 errors;
+};
+
+static int
+_bmc_posted_cmp(const void *a, const void *b)
+{
+	const struct bmc_posted_reg *x = a, *y = b;
+
+	return (x->reg > y->reg) - (x->reg < y->reg);
+}
+
+static int
+_bmc_posted_flush(struct bmc_posted *p)
+{
+	struct bmc_regmap *bmc = p->bmc;
+	u8 buf[4 + BMC_BURST_MAX];
+	u32 i, j, len;
+	int e, err = 0;
+
+	if (!p->n)
+		return 0;
+
+	sort(p->q, p->n, sizeof(p->q[0]), _bmc_posted_cmp, NULL);
+	for (i = 0; i < p->n; i = j) {
+		put_unaligned_le32(p->q[i].reg, buf);
+		len = 0;
+		j = i;
+		do {
+			put_unaligned_le32(p->q[j].val, &buf[4 + len]);
+			len += 4;
+			++j;
+		} while ((j < p->n) && (len < BMC_BURST_MAX) &&
+			 (p->q[j].reg == p->q[j - 1].reg + 4));
+
+		e = _bmc_write_run(bmc, buf, 4 + len);
+		p->xfers += bmc->access->burst ? 1 : len / 4;
+		if (e) {
+			++p->errors;
+			dev_err_ratelimited(bmc->dev, "posted write %#x failed; status %d\n",
+					    p->q[i].reg, e);
+			if (!err)
+				err = e;
+		}
+	}
+	p->n = 0;
+	++p->flushes;
+	return err;
+}
+
+static void
+_bmc_posted_drain(struct bmc_posted *p)
+{
+	mutex_lock(&p->lock);
+	_bmc_posted_flush(p);
+	mutex_unlock(&p->lock);
+}
+
+static void
+_bmc_posted_work(struct work_struct *work)
+{
+	_bmc_posted_drain(container_of(to_delayed_work(work),
+				       struct bmc_posted, work));
+}
+
+static int
+_bmc_post(struct bmc_posted *p, u32 reg, const u8 *v, size_t len)
+{
+	size_t i;
+	u32 k;
+
+	/* do not report success for a write that cannot be made */
+	if (cisco_fpga_mfd_link_lost(p->bmc->mfd))
+		return -ENODEV;
+
+	mutex_lock(&p->lock);
+	for (i = 0; i < len; i += 4, reg += 4) {
+		++p->writes;
+		for (k = 0; k < p->n; ++k)
+			if (p->q[k].reg == reg)
+				break;
+		if (k < p->n) {
+			++p->coalesced;
+		} else {
+			if (p->n >= p->depth)
+				_bmc_posted_flush(p);
+			k = p->n++;
+			p->q[k].reg = reg;
+		}
+		p->q[k].val = get_unaligned_le32(&v[i]);
+	}
+	if (p->n)
+		schedule_delayed_work(&p->work, usecs_to_jiffies(p->latency_us));
+	mutex_unlock(&p->lock);
+	return 0;
+}
+
+/*
+ * Reads see the values written before them.
+ */
+static void
+_bmc_posted_sync(struct bmc_posted *p, u32 reg, size_t len)
+{
+	u32 k;
+
+	mutex_lock(&p->lock);
+	for (k = 0; k < p->n; ++k) {
+		if ((p->q[k].reg >= reg) && (p->q[k].reg < reg + len)) {
+			++p->read_flushes;
+			_bmc_posted_flush(p);
+			break;
+		}
+	}
+	mutex_unlock(&p->lock);
+}
+
+static int
+_bmc_posted_show(struct seq_file *m, void *v)
+{
+	struct bmc_posted *p = m->private;
+
+	mutex_lock(&p->lock);
+	seq_printf(m, "enabled %u\nlatency_us %u\ndepth %u\nqueued %u\n"
+		   "writes %llu\ncoalesced %llu\nxfers %llu\nflushes %llu\n"
+		   "read_flushes %llu\nerrors %llu\n",
+		   p->enabled, p->latency_us, p->depth, p->n,
+		   p->writes, p->coalesced, p->xfers, p->flushes,
+		   p->read_flushes, p->errors);
+	/* registers written per bus transaction, in hundredths */
+	seq_printf(m, "ratio %llu\n",
+		   p->xfers ? div64_u64(p->writes * 100, p->xfers) : 0);
+	mutex_unlock(&p->lock);
+	return 0;
+}
+
+static int
+_bmc_posted_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, _bmc_posted_show, inode->i_private);
+}
+
+/*
+ * Commands:
+ *   enable | disable  - post writes, or write through after a flush
+ *   latency_us <n>    - write queued registers out after n us
+ *   depth <n>         - write queued registers out at n registers
+ *   flush             - write queued registers out now
+ *   clear             - reset the counters
+ */
+static ssize_t
+_bmc_posted_write(struct file *file, const char __user *ubuf,
+		  size_t count, loff_t *ppos)
+{
+	struct bmc_posted *p = ((struct seq_file *)file->private_data)->private;
+	char buf[32];
+	ssize_t len;
+	u32 n;
+	int err = 0;
+
+	len = simple_write_to_buffer(buf, sizeof(buf) - 1, ppos, ubuf, count);
+	if (len < 0)
+		return len;
+	buf[len] = 0;
+
+	mutex_lock(&p->lock);
+	if (sysfs_streq(buf, "enable")) {
+		p->enabled = true;
+	} else if (sysfs_streq(buf, "disable")) {
+		p->enabled = false;
+		err = _bmc_posted_flush(p);
+	} else if (sscanf(buf, "latency_us %u", &n) == 1) {
+		p->latency_us = n;
+	} else if ((sscanf(buf, "depth %u", &n) == 1) &&
+		   n && (n <= BMC_POSTED_MAX)) {
+		p->depth = n;
+		if (p->n >= n)
+			err = _bmc_posted_flush(p);
+	} else if (sysfs_streq(buf, "flush")) {
+		err = _bmc_posted_flush(p);
+	} else if (sysfs_streq(buf, "clear")) {
+		p->writes = p->coalesced = p->xfers = 0;
+		p->flushes = p->read_flushes = p->errors = 0;
 	} else {
-		buf[0] = val & 0xff;
-		buf[1] = (val >> 8) & 0xff;
-		buf[2] = (val >> 16) & 0xff;
-		buf[3] = (val >> 24) & 0xff;
-		msg.addr = i2c->addr + 5;
-		ret = __i2c_transfer(i2c->adapter, &msg, 1);
-		if (ret < 1)
-			err = -EIO;
+		err = -EINVAL;
 	}
-	i2c_unlock_bus(i2c->adapter, I2C_LOCK_ROOT_ADAPTER);
+	mutex_unlock(&p->lock);
+	return err ? err : count;
+}
+
+static const struct file_operations _bmc_posted_fops = {
+	.owner = THIS_MODULE,
+	.open = _bmc_posted_open,
+	.read = seq_read,
+	.write = _bmc_posted_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void
+_bmc_posted_release(void *data)
+{
+	struct bmc_posted *p = data;
+
+	debugfs_remove(p->file);
+	cancel_delayed_work_sync(&p->work);
+	mutex_lock(&p->lock);
+	_bmc_posted_flush(p);
+	p->enabled = false;
+	mutex_unlock(&p->lock);
+	p->bmc->posted = NULL;
+	kfree(p);
+}
+
+static int
+_bmc_posted_init(struct device *dev, struct bmc_regmap *bmc)
+{
+	struct dentry *parent = cisco_fpga_debugfs_dir(dev);
+	struct bmc_posted *p;
+
+	if (IS_ERR_OR_NULL(parent))
+		return parent ? PTR_ERR(parent) : -ENODEV;
+
+	p = kzalloc(sizeof(*p), GFP_KERNEL);
+	if (!p)
+		return -ENOMEM;
+
+	p->bmc = bmc;
+	mutex_init(&p->lock);
+	INIT_DELAYED_WORK(&p->work, _bmc_posted_work);
+	p->enabled = m_posted;
+	p->latency_us = m_posted_latency_us;
+	p->depth = BMC_POSTED_MAX;
+	bmc->posted = p;
+	p->file = debugfs_create_file("posted", 0600, parent, p,
+				      &_bmc_posted_fops);
+	return devm_add_action_or_reset(dev, _bmc_posted_release, p);
+}
+
+/*
+ * regmap_bus read; reg_buf and val_buf are little endian, as on the
+ * wire.
+ */
+static int
+_bmc_bus_read(void *context, const void *reg_buf, size_t reg_size,
+	      void *val_buf, size_t val_size)
+{
+	struct bmc_regmap *bmc = (typeof(bmc))context;
+	u32 reg = get_unaligned_le32(reg_buf);
+	u8 *v = val_buf;
+	size_t i;
+	int err;
+
+	if (bmc->posted) {
+		if (bmc->accesses++)
+			_bmc_posted_drain(bmc->posted);
+		else
+			_bmc_posted_sync(bmc->posted, reg, val_size);
+	}
+
+	if (cisco_fpga_mfd_link_lost(bmc->mfd))
+		return -ENODEV;
+
+	err = _bmc_xfer(bmc, reg + bmc->base, v, val_size, true);
+	for (i = 0; i < val_size; i += 4)
+		reg_trace_access(bmc->dev, REG_TRACE_OP_READ,
+				 (const void __iomem *)(uintptr_t)(reg + bmc->base + i),
+				 err ? 0 : get_unaligned_le32(&v[i]), err);
+	for (i = 0; !err && (i < val_size); i += 4)
+		err = cisco_fpga_mfd_link_check(bmc->mfd, bmc->dev, reg + i,
+						get_unaligned_le32(&v[i]),
+						_bmc_read, bmc);
 	return err;
 }
 
+/*
+ * regmap_bus write
+ */
+static int
+_bmc_bus_write(void *context, const void *data, size_t count)
+{
+	struct bmc_regmap *bmc = (typeof(bmc))context;
+	struct bmc_posted *p = bmc->posted;
+
+	if (p) {
+		if (!bmc->accesses++ && p->enabled)
+			return _bmc_post(p, get_unaligned_le32(data),
+					 (const u8 *)data + 4, count - 4);
+		_bmc_posted_drain(p);
+	}
+	return _bmc_write_run(bmc, data, count);
+}
+
+/*
+ * Cell regmap lock; counts the accesses made under it for posting.
+ */
+static void
+_bmc_regmap_lock(void *arg)
+{
+	struct bmc_regmap *bmc = arg;
+
+	mutex_lock(&bmc->lock);
+	bmc->accesses = 0;
+}
+
+static void
+_bmc_regmap_unlock(void *arg)
+{
+	struct bmc_regmap *bmc = arg;
+
+	mutex_unlock(&bmc->lock);
+}
+
+static const struct regmap_bus _bmc_bus = {
+	.read = _bmc_bus_read,
+	.write = _bmc_bus_write,
+	.reg_format_endian_default = REGMAP_ENDIAN_LITTLE,
+	.val_format_endian_default = REGMAP_ENDIAN_LITTLE,
+	.max_raw_read = BMC_BURST_MAX,
+	.max_raw_write = BMC_BURST_MAX,
+};
+
 static const struct regmap_config _bmc_regmap_config = {
 	.reg_bits = 32,
 	.val_bits = 32,
 	.reg_stride = 4,
-	.reg_write = _bmc_write,
-	.reg_read = _bmc_read,
 	.fast_io = false,
 };
 
+/*
+ * Auto-increment is taken from the info_rom header version, and only
+ * trusted once a burst of the info_rom header matches single reads.
+ * Without it, the latch is only relied upon once a read of info0 that
+ * leaves out the address phase is seen to return info0 again.  All of
+ * it runs under the root adapter lock, so that cells see either the
+ * old access mode or the new one.
+ */
+static void
+_bmc_probe_access(struct bmc_regmap *bmc)
+{
+	struct i2c_adapter *adap = bmc->i2c->adapter;
+	struct bmc_access *a = bmc->access;
+	struct regblk_hdr_t hdr;
+	u32 info0, magic;
+	u8 buf[4];
+
+	i2c_lock_bus(adap, I2C_LOCK_ROOT_ADAPTER);
+	a->latch_known = false;
+	a->latch_valid = false;
+	a->autoinc = false;
+	a->burst = false;
+	if (__bmc_xfer(bmc, bmc->base + offsetof(struct regblk_hdr_t, info0),
+		       buf, sizeof(buf), true))
+		goto out;
+	info0 = get_unaligned_le32(buf);
+	if (__bmc_xfer(bmc, bmc->base + offsetof(struct regblk_hdr_t, magicNo),
+		       buf, sizeof(buf), true))
+		goto out;
+	magic = get_unaligned_le32(buf);
+	if (magic != CISCO_FPGA_MAGIC)
+		goto out;
+
+	if ((REG_GET(HDR_INFO0_MAJORVER, info0) >= BMC_BURST_INFO_VER) &&
+	    !__bmc_xfer(bmc, bmc->base, (u8 *)&hdr, sizeof(hdr), true))
+		a->autoinc = (get_unaligned_le32(&hdr.info0) == info0) &&
+			     (get_unaligned_le32(&hdr.magicNo) == magic);
+	a->burst = a->autoinc && m_burst;
+
+	/* the latch moved under the burst without a->autoinc set */
+	a->latch_valid = false;
+	if (a->autoinc) {
+		a->latch_known = true;
+		goto out;
+	}
+
+	if (!__bmc_xfer(bmc, bmc->base, buf, sizeof(buf), true)) {
+		a->latch_known = true;
+		if (__bmc_xfer(bmc, bmc->base, buf, sizeof(buf), true) ||
+		    (get_unaligned_le32(buf) != info0))
+			a->latch_known = false;
+	}
+out:
+	a->latch_valid = false;
+	i2c_unlock_bus(adap, I2C_LOCK_ROOT_ADAPTER);
+}
+
 static int
 _bmc_regmap(struct platform_device *pdev, size_t priv_size, uintptr_t *base,
 	    const struct regmap_config *r_configp)
@@ -137,9 +651,6 @@ _bmc_regmap(struct platform_device *pdev, size_t priv_size, uintptr_t *base,
 	struct regmap_config regmap_config =
 	    r_configp ? *r_configp : _bmc_regmap_config;
 
-	regmap_config.reg_write = _bmc_write;
-	regmap_config.reg_read = _bmc_read;
-
 	if (!mfd)
 		return -ENXIO;
 
@@ -158,34 +669,55 @@ _bmc_regmap(struct platform_device *pdev, size_t priv_size, uintptr_t *base,
 
 	priv->base = res->start;
 	priv->i2c = mfd->r.i2c;
+	priv->dev = dev;
+	priv->mfd = &mfd->mfd;
+	priv->access = mfd->r.access;
+	mutex_init(&priv->lock);
+	regmap_config.disable_locking = false;
+	regmap_config.lock = _bmc_regmap_lock;
+	regmap_config.unlock = _bmc_regmap_unlock;
+	regmap_config.lock_arg = priv;
 
 	// ACPI_COMPANION_SET(&hw->adap.dev, ACPI_COMPANION(dev));
-	r = devm_regmap_init(dev, NULL, priv, &regmap_config);
+	r = devm_regmap_init(dev, &_bmc_bus, priv, &regmap_config);
 	if (IS_ERR(r))
 		return PTR_ERR(r);
 
+	/* posting is optional; carry on without it */
+	if (_bmc_posted_init(dev, priv))
+		dev_dbg(dev, "posted writes unavailable\n");
+
 	if (base)
 		*base = priv->base;
 
 	return 0;
 }
 
+static const struct resource _bmc_cell_template = {
+	.flags = IORESOURCE_MEM,
+	.name = "cell",
+};
+
 static struct cell_metadata *
 _bmc_probe_regmap(struct i2c_client *client, struct bmc_regmap *priv)
 {
 	struct device *dev = &client->dev;
+	struct bmc_mfd *mfd = i2c_get_clientdata(client);
 	struct regmap *r;
 	struct cell_metadata *meta;
-	struct resource template = {
-		.flags = IORESOURCE_MEM,
-		.name = "cell",
-	};
 
-	r = devm_regmap_init(dev, NULL, priv, &_bmc_regmap_config);
+	if (mfd->mfd.shared)
+		return cisco_fpga_mfd_cells(dev, mfd->mfd.shared,
+					    &_bmc_cell_template, NULL, 0,
+					    CISCO_MFD_CELLS_FILTER_REGMAP,
+					    m_mfd_debug);
+
+	/* not attached to dev, as regmap_exit() leaves devres entries behind */
+	r = regmap_init(NULL, &_bmc_bus, priv, &_bmc_regmap_config);
 	if (IS_ERR(r)) {
 		meta = (typeof(meta))r;
 	} else {
-		meta = cisco_fpga_mfd_cells(dev, r, &template,
+		meta = cisco_fpga_mfd_cells(dev, r, &_bmc_cell_template,
 					    NULL, 0,
 					    CISCO_MFD_CELLS_FILTER_REGMAP,
 					    m_mfd_debug);
@@ -194,6 +726,59 @@ _bmc_probe_regmap(struct i2c_client *client, struct bmc_regmap *priv)
 	return meta;
 }
 
+/*
+ * Writing 1 re-enumerates the FPGA after it has been reprogrammed,
+ * replacing only the cells whose blocks changed.
+ */
+static ssize_t
+rescan_store(struct device *dev, struct device_attribute *attr,
+	     const char *buf, size_t count)
+{
+	struct bmc_mfd *priv = dev_get_drvdata(dev);
+	struct regmap *r;
+	bool rescan;
+	int err;
+
+	err = kstrtobool(buf, &rescan);
+	if (err)
+		return err;
+	if (!rescan)
+		return count;
+
+	/*
+	 * A reprogrammed FPGA starts with nothing latched, and may move the
+	 * latch differently; kept cells share the new access mode.
+	 */
+	_bmc_probe_access(&priv->r);
+
+	r = priv->mfd.shared;
+	if (!r) {
+		r = regmap_init(NULL, &_bmc_bus, &priv->r, &_bmc_regmap_config);
+		if (IS_ERR(r))
+			return PTR_ERR(r);
+	}
+	err = cisco_fpga_mfd_rescan(dev, r, &_bmc_cell_template, NULL, 0,
+				    CISCO_MFD_CELLS_FILTER_REGMAP,
+				    m_mfd_debug);
+	if (r != priv->mfd.shared)
+		regmap_exit(r);
+	return err ? err : count;
+}
+static DEVICE_ATTR_WO(rescan);
+
+static struct attribute *_bmc_attrs[] = {
+	&dev_attr_rescan.attr,
+	NULL,
+};
+static const struct attribute_group _bmc_attr_group = {
+	.name = NULL,
+	.attrs = _bmc_attrs,
+};
+static const struct attribute_group *_bmc_attr_groups[] = {
+	&_bmc_attr_group,
+	NULL,
+};
+
 static int cisco_fpga_bmc_probe(struct i2c_client *client,
 				const struct i2c_device_id *id)
 {
@@ -206,10 +791,30 @@ static int cisco_fpga_bmc_probe(struct i2c_client *client,
 		return -ENOMEM;
 
 	priv->r.i2c = client;
+	priv->r.dev = &client->dev;
+	priv->r.access = &priv->access;
 	priv->r.base = 0;
+	priv->access.combined = i2c_check_functionality(client->adapter,
+						   I2C_FUNC_I2C);
 	i2c_set_clientdata(client, priv);
 	cisco_fpga_mfd_parent_init(&client->dev, &priv->mfd, _bmc_regmap);
 
+	_bmc_probe_access(&priv->r);
+	dev_dbg(&client->dev, "%s %s register access%s\n",
+		priv->access.combined ? "combined" : "split",
+		priv->access.burst ? "burst" : "single",
+		priv->access.latch_known ? "; latch cached" : "");
+
+	if (m_shared_regmap) {
+		struct regmap *r;
+
+		r = devm_regmap_init(&client->dev, &_bmc_bus, &priv->r,
+				     &_bmc_regmap_config);
+		if (IS_ERR(r))
+			return PTR_ERR(r);
+		cisco_fpga_mfd_shared_parent_init(&priv->mfd, r);
+	}
+
 	meta = _bmc_probe_regmap(client, &priv->r);
 	if (IS_ERR(meta))
 		return PTR_ERR(meta);
@@ -217,6 +822,12 @@ static int cisco_fpga_bmc_probe(struct i2c_client *client,
 	err = devm_mfd_add_devices(&client->dev, 0, meta->cells, meta->ncells,
 				   NULL, 0, 0 /*hw->pdata.domain */);
 	kfree(meta);
+	if (err)
+		return err;
+
+	err = devm_device_add_groups(&client->dev, _bmc_attr_groups);
+	if (err)
+		dev_err(&client->dev, "devm_device_add_groups failed; status %d\n", err);
 	return err;
 }
 
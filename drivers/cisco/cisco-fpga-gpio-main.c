@@ -511,6 +511,40 @@ get_reboot_type_str(void)
 	return "illegal";
 }
 
+/*
+ * Only the block configuration (and read-only header) is cached;
+ * the per-pin registers reflect pin state and are volatile.
+ */
+static const struct regmap_range _cached_ranges[] = {
+	CISCO_HDR_CACHED_RANGES,
+	regmap_reg_range(offsetof(struct gpio_regs_v5_t, cfg0),
+			 offsetof(struct gpio_regs_v5_t, cfg1)),
+};
+
+static const struct regmap_access_table _volatile_table = {
+	.no_ranges = _cached_ranges,
+	.n_no_ranges = ARRAY_SIZE(_cached_ranges),
+};
+
+static const struct reg_field_layout_t gpio_regs_v5_t_cfg0_field_layout[] = {
+	REG_FIELD_LAYOUT(GPIO_CFG0_REMAPEN, 0),
+	REG_FIELD_LAYOUT(GPIO_CFG0_REMAPRDWREN, 0),
+	REG_FIELD_LAYOUT_TERMINATOR
+};
+
+static const struct reg_field_layout_t gpio_regs_v5_t_cfg1_field_layout[] = {
+	REG_FIELD_LAYOUT(GPIO_CFG1_DLYDUR, 0),
+	REG_FIELD_LAYOUT(GPIO_CFG1_FLTDUR, 0),
+	REG_FIELD_LAYOUT_TERMINATOR
+};
+
+/* The per pin registers are decoded by the gpiolib debugfs file. */
+static const struct reg_layout_t gpio_regs_v5_t_layout[] = {
+	REG_LAYOUT(GPIO_CFG0),
+	REG_LAYOUT(GPIO_CFG1),
+	REG_LAYOUT_TERMINATOR
+};
+
 static int
 _gpio_probe(struct platform_device *pdev)
 {
@@ -529,6 +563,8 @@ _gpio_probe(struct platform_device *pdev)
 		.reg_stride = 4,
 		.fast_io = false,
 		.max_register = sizeof(struct gpio_regs_v5_t) - 1,
+		.volatile_table = &_volatile_table,
+		.cache_type = REGCACHE_RBTREE,
 	};
 	struct regmap *map;
 
@@ -567,6 +603,10 @@ _gpio_probe(struct platform_device *pdev)
 	priv->map = map;
 	priv->dev = dev;
 
+	e = cisco_reg_layout_debugfs_init(dev, map, gpio_regs_v5_t_layout);
+	if (e)
+		dev_warn(dev, "cisco_reg_layout_debugfs_init failed; status %d\n", e);
+
 	if (m_reboot_type >= MAX_REBOOT_TYPE)
 		m_reboot_type = UNSET;
 
@@ -17,6 +17,7 @@
 #include "cisco/reg_access.h"
 #include "cisco/hdr.h"
 #include "cisco/gpio.h"
+#include "cisco/sysfs.h"
 //#include "polaris/cisco-fpga-gpio.h"
 
 static inline void
@@ -542,6 +543,7 @@ config_store(struct device *dev,
 		}
 		break;
 	}
+	cisco_fpga_sysfs_cache_invalidate(dev);
 	kfree(name);
 	return result;
 }
@@ -597,6 +599,7 @@ set_store(struct device *dev,
 		return -EINVAL;
 	v = REG_SET(GPIO_IO_SET_OUTSTATE, 1);
 	rc = gpio_iowrite32(priv, v, &io->set);
+	cisco_fpga_sysfs_cache_invalidate(dev);
 	if (rc)
 		return rc;
 	return buflen;
@@ -631,6 +634,7 @@ clear_store(struct device *dev,
 		return -EINVAL;
 	v = REG_SET(GPIO_IO_CLR_OUTSTATE, 1);
 	rc = gpio_iowrite32(priv, v, &io->clr);
+	cisco_fpga_sysfs_cache_invalidate(dev);
 	if (rc)
 		return rc;
 	return buflen;
@@ -14,17 +14,21 @@
 #include <linux/acpi.h>
 #include <linux/slab.h>
 #include <linux/regmap.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include "cisco/mfd.h"
 #include "cisco/reg_access.h"
 #include "cisco/i2c-arbitrate.h"
 #include "cisco/i2c-ext.h"
+#include "cisco/util.h"
 
 #define DRIVER_NAME                 "cisco-fpga-i2c-ext"
 #define DRIVER_VERSION              "1.0"
 #define DRIVER_I2C_DEBUG_LEVEL      0
 #define DRIVER_I2C_HW_BUF_SIZE      256
 #define DRIVER_I2C_HW_BUF_SIZE_v5   512
+#define DRIVER_FLIGHT_SIZE          4096
 
 #define F(hw, addr) (((u8 *)addr) - ((u8 *)hw->csr))
 
@@ -46,17 +50,165 @@ MODULE_PARM_DESC(m_error_trace, "Generate register trace on error. bit: 0=fault;
 
 #define DEFAULT_SPEED   i2c_ext_cfg_spdCnt__100Kbps
 
+/*
+ * Flight recorder.
+ *
+ * Each adapter always keeps its most recent register accesses and
+ * transfer descriptors in a small trace that overwrites its oldest
+ * records.  When a transfer fails with an error class selected in
+ * m_error_trace, the trace is copied aside and kept until cleared by a
+ * write to debugfs cisco-fpga/<device>/flight/<adapter>.  Later errors
+ * do not replace a frozen trace.
+ *
+ * The adapters of a block share one bus lock, which also serializes the
+ * live traces and hw->flight_cur.
+ */
+enum {
+	FLIGHT_OP_READ = REG_TRACE_OP_READ,
+	FLIGHT_OP_WRITE = REG_TRACE_OP_WRITE,
+	FLIGHT_OP_XFER = REG_TRACE_OP_NEXT,
+	FLIGHT_OP_ERROR,
+};
+
+struct flight_reg_t {
+	u16 offset;
+	s16 e;
+	u32 value;
+};
+
+struct flight_xfer_t {
+	u32 cfg;
+	u32 cfg2;
+	u16 addr;
+	u16 flags;
+	u16 len;		/* bytes left in the message */
+	u16 dev_sel;
+};
+
+struct flight_error_t {
+	s32 e;
+	u32 class;
+};
+
+struct i2c_ext_flight {
+	struct reg_trace_t live;
+	struct mutex lock;		/* frozen */
+	struct reg_trace_t frozen;
+	bool is_frozen;
+	u32 class;
+	int e;
+	u64 freezes;
+};
+
+static const char * const _flight_class_name[] = {
+	[M_ERROR_TRACE_FAULT] = "fault",
+	[M_ERROR_TRACE_BUSY] = "busy",
+	[M_ERROR_TRACE_TIMEOUT] = "timeout",
+	[M_ERROR_TRACE_OTHER] = "other",
+};
+
+static inline void
+_flight_reg(struct cisco_fpga_i2c *hw, u16 op,
+	    void __iomem *addr, u32 v, int e)
+{
+	struct flight_reg_t r = {
+		.offset = F(hw, addr),
+		.e = e,
+		.value = v,
+	};
+
+	if (hw->flight_cur)
+		reg_trace(&hw->flight_cur->live, op, &r, sizeof(r));
+}
+
+static void
+_flight_xfer(struct cisco_fpga_i2c *hw, const struct i2c_msg *msg,
+	     u32 cfg, u32 cfg2, u16 len, u32 dev_sel)
+{
+	struct flight_xfer_t x = {
+		.cfg = cfg,
+		.cfg2 = cfg2,
+		.addr = msg->addr,
+		.flags = msg->flags,
+		.len = len,
+		.dev_sel = dev_sel,
+	};
+
+	if (hw->flight_cur)
+		reg_trace(&hw->flight_cur->live, FLIGHT_OP_XFER, &x, sizeof(x));
+}
+
+static u32
+_flight_class(int e)
+{
+	switch (e) {
+	case -EFAULT:
+		return M_ERROR_TRACE_FAULT;
+	case -EBUSY:
+		return M_ERROR_TRACE_BUSY;
+	case -EAGAIN:
+	case -ETIMEDOUT:
+		return M_ERROR_TRACE_TIMEOUT;
+	default:
+		return M_ERROR_TRACE_OTHER;
+	}
+}
+
+/* Record a failure and freeze the trace if its class is selected. */
+static void
+_flight_error(struct i2c_adapter *adap, struct cisco_fpga_i2c *hw, int e)
+{
+	struct i2c_ext_flight *f = hw->flight_cur;
+	struct flight_error_t r = {
+		.e = e,
+		.class = _flight_class(e),
+	};
+	bool froze = false;
+
+	if (!f)
+		return;
+	reg_trace(&f->live, FLIGHT_OP_ERROR, &r, sizeof(r));
+	if (!(READ_ONCE(m_error_trace) & BIT(r.class)))
+		return;
+
+	mutex_lock(&f->lock);
+	if (!f->is_frozen) {
+		uint8_t *base = f->frozen.base;
+
+		memcpy(base, f->live.base, f->live.size);
+		f->frozen = f->live;
+		f->frozen.base = base;
+		f->frozen.limit = base + f->frozen.size;
+		f->is_frozen = true;
+		f->class = r.class;
+		f->e = e;
+		f->freezes++;
+		froze = true;
+	}
+	mutex_unlock(&f->lock);
+
+	if (froze)
+		dev_warn(&adap->dev, "%s error %d; flight recorder frozen\n",
+			 _flight_class_name[r.class], e);
+}
+
 static inline int
 _i2c_writel(struct cisco_fpga_i2c *hw,
 	    uint32_t v, void __iomem *addr)
 {
-	return regmap_write(hw->regmap, F(hw, addr), v);
+	int e = regmap_write(hw->regmap, F(hw, addr), v);
+
+	_flight_reg(hw, FLIGHT_OP_WRITE, addr, v, e);
+	return e;
 }
 
 static inline int
 _i2c_readl(struct cisco_fpga_i2c *hw, void __iomem *addr, u32 *val)
 {
-	return regmap_read(hw->regmap, F(hw, addr), val);
+	int e = regmap_read(hw->regmap, F(hw, addr), val);
+
+	_flight_reg(hw, FLIGHT_OP_READ, addr, e ? 0 : *val, e);
+	return e;
 }
 
 static u32
@@ -97,8 +249,11 @@ _i2c_reset(struct i2c_adapter *adap, struct cisco_fpga_i2c *hw)
 static int
 cisco_fpga_i2c_recover_bus(struct i2c_adapter *adap)
 {
+	struct cisco_fpga_i2c *hw = i2c_get_adapdata(adap);
+
 	dev_warn(&adap->dev, "bus recovery\n");
-	return _i2c_reset(adap, i2c_get_adapdata(adap));
+	hw->flight_cur = &hw->flight[adap - hw->adap];
+	return _i2c_reset(adap, hw);
 }
 
 static int
@@ -127,6 +282,8 @@ _wait_done(struct i2c_adapter *adap, struct cisco_fpga_i2c *hw, u32 cfg_len)
 			} while (!e &&
 				 REG_GET(I2C_EXT_CFG_STARTACCESS, val) &&
 				 !time_after(jiffies, timeout));
+			/* only the outcome of the poll is recorded */
+			_flight_reg(hw, FLIGHT_OP_READ, &csr->cfg, e ? 0 : val, e);
 		}
 		if (!e && REG_GET(I2C_EXT_CFG_STARTACCESS, val))
 			e = -EBUSY;
@@ -167,6 +324,7 @@ _retryable_cfg(struct i2c_adapter *adap, struct cisco_fpga_i2c *hw, u32 cfg, u32
 				e = _check_err(hw);
 		}
 		if (e) {
+			_flight_error(adap, hw, e);
 			(void)_i2c_reset(adap, hw);
 			_clear_intr_status(hw);
 		}
@@ -222,6 +380,7 @@ _i2c_xfer(struct i2c_adapter *adap, struct cisco_fpga_i2c *hw, struct i2c_msg *m
 
 	e = _wait_done(adap, hw, 0);
 	if (e) {
+		_flight_error(adap, hw, e);
 		dev_err(dev, "%s:%d %s %d error %d adapter is busy?\n",
 			__func__, __LINE__, adap->name, dev_sel, e);
 		goto error_exit;
@@ -244,10 +403,11 @@ _i2c_xfer(struct i2c_adapter *adap, struct cisco_fpga_i2c *hw, struct i2c_msg *m
 
 		index = 0;
 		cfg_len = (len > hw->bufsize) ? hw->bufsize : len;
-
-		if (!read) {
+		if (!read)
 			cfg2 = REG_SET(I2C_EXT_CFG2_WDATASIZE, cfg_len);
+		_flight_xfer(hw, msg, cfg, cfg2, len, dev_sel);
 
+		if (!read) {
 			while (len && cfg_len && !e) {
 				u16 cp_len = (cfg_len > 3) ? 4 : len;
 				u8 *datac = (u8 *) &data;
@@ -299,6 +459,8 @@ cisco_fpga_i2c_xfer(struct i2c_adapter *adap, struct i2c_msg *msg, int num)
 	int i, err;
 	struct device *dev = adap->dev.parent;
 
+	hw->flight_cur = &hw->flight[adap - hw->adap];
+
 	/* clear interrupts */
 	err = _clear_intr_status(hw);
 
@@ -327,6 +489,259 @@ static struct i2c_bus_recovery_info cisco_fpga_i2c_recovery = {
 	.recover_bus    = cisco_fpga_i2c_recover_bus,
 };
 
+/*
+ * Interrupt configuration (and the read-only header) is cached; the
+ * transfer registers are volatile.
+ */
+static const struct regmap_range _cached_ranges[] = {
+	CISCO_HDR_CACHED_RANGES,
+	regmap_reg_range(offsetof(struct i2c_ext_regs_v5_t, intrCfg0),
+			 offsetof(struct i2c_ext_regs_v5_t, intrCfg1)),
+};
+
+static const struct regmap_access_table _volatile_table = {
+	.no_ranges = _cached_ranges,
+	.n_no_ranges = ARRAY_SIZE(_cached_ranges),
+};
+
+/*
+ * Reading the receive buffers has side effects on a transfer in flight;
+ * they are only read by the transfer itself, never by snapshots.
+ */
+static const struct regmap_range _precious_ranges[] = {
+	regmap_reg_range(offsetof(struct i2c_ext_regs_v5_t, rdata),
+			 sizeof(struct i2c_ext_regs_v5_t) - 4),
+};
+
+static const struct regmap_access_table _precious_table = {
+	.yes_ranges = _precious_ranges,
+	.n_yes_ranges = ARRAY_SIZE(_precious_ranges),
+};
+
+static void
+_flight_show_rec(struct reg_trace_t *tracep,
+		 void *cookie,
+		 const struct reg_trace_hdr_t *hdrp,
+		 const uint8_t *datap)
+{
+	struct seq_file *m = cookie;
+	const struct flight_reg_t *r = (const void *)datap;
+	const struct flight_xfer_t *x = (const void *)datap;
+	const struct flight_error_t *err = (const void *)datap;
+
+	seq_printf(m, "%lld.%09ld ", (long long)hdrp->ts.tv_sec, hdrp->ts.tv_nsec);
+	switch (hdrp->op) {
+	case FLIGHT_OP_READ:
+	case FLIGHT_OP_WRITE:
+		if (hdrp->len < sizeof(*r))
+			break;
+		seq_printf(m, "%c %#06x %#010x %d\n",
+			   (hdrp->op == FLIGHT_OP_READ) ? 'R' : 'W',
+			   r->offset, r->value, r->e);
+		return;
+	case FLIGHT_OP_XFER:
+		if (hdrp->len < sizeof(*x))
+			break;
+		seq_printf(m, "X cfg %#010x cfg2 %#010x addr %#05x flags %#06x len %u devsel %u\n",
+			   x->cfg, x->cfg2, x->addr, x->flags, x->len, x->dev_sel);
+		return;
+	case FLIGHT_OP_ERROR:
+		if (hdrp->len < sizeof(*err))
+			break;
+		seq_printf(m, "E %s %d\n",
+			   _flight_class_name[err->class], err->e);
+		return;
+	}
+	seq_printf(m, "? op %u len %u\n", hdrp->op, hdrp->len);
+}
+
+static int
+_flight_show(struct seq_file *m, void *p)
+{
+	struct i2c_ext_flight *f = m->private;
+	struct reg_trace_t t;
+
+	mutex_lock(&f->lock);
+	seq_printf(m, "# classes %#lx freezes %llu\n",
+		   READ_ONCE(m_error_trace), f->freezes);
+	if (f->is_frozen) {
+		seq_printf(m, "# frozen on %s error %d\n",
+			   _flight_class_name[f->class], f->e);
+		/* walk a copy so the frozen trace can be read again */
+		t = f->frozen;
+		reg_trace_walk(&t, _flight_show_rec, m);
+	}
+	mutex_unlock(&f->lock);
+	return 0;
+}
+
+static int
+_flight_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, _flight_show, inode->i_private);
+}
+
+/* Any write clears the freeze. */
+static ssize_t
+_flight_write(struct file *file, const char __user *buf,
+	      size_t count, loff_t *ppos)
+{
+	struct i2c_ext_flight *f = ((struct seq_file *)file->private_data)->private;
+
+	mutex_lock(&f->lock);
+	f->is_frozen = false;
+	reg_trace_reset(&f->frozen);
+	mutex_unlock(&f->lock);
+	return count;
+}
+
+static const struct file_operations _flight_fops = {
+	.owner = THIS_MODULE,
+	.open = _flight_open,
+	.read = seq_read,
+	.write = _flight_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void
+_flight_release(void *data)
+{
+	struct cisco_fpga_i2c *hw = data;
+	u8 i;
+
+	/* the files point into hw->flight */
+	debugfs_remove_recursive(hw->flight_dir);
+	hw->flight_dir = NULL;
+
+	for (i = 0; i < hw->num_adapters; ++i) {
+		reg_trace_free(&hw->flight[i].live);
+		reg_trace_free(&hw->flight[i].frozen);
+		mutex_destroy(&hw->flight[i].lock);
+	}
+	kfree(hw->flight);
+	hw->flight = NULL;
+}
+
+/*
+ * The recorder is released after the adapters are deleted, which are
+ * set up later.  The per-device debugfs directory is set up earlier and
+ * outlives it, so the flight directory is removed with the recorder.
+ */
+static int
+_flight_init(struct device *dev, struct cisco_fpga_i2c *hw)
+{
+	struct dentry *parent, *dir;
+	char name[8];
+	int e;
+	u8 i;
+
+	hw->flight = kcalloc(hw->num_adapters, sizeof(*hw->flight), GFP_KERNEL);
+	if (!hw->flight)
+		return -ENOMEM;
+	for (i = 0; i < hw->num_adapters; ++i)
+		mutex_init(&hw->flight[i].lock);
+	e = devm_add_action_or_reset(dev, _flight_release, hw);
+	if (e)
+		return e;
+
+	for (i = 0; i < hw->num_adapters; ++i) {
+		struct i2c_ext_flight *f = &hw->flight[i];
+
+		e = reg_trace_init(&f->live, DRIVER_FLIGHT_SIZE);
+		if (!e)
+			e = reg_trace_init(&f->frozen, DRIVER_FLIGHT_SIZE);
+		if (e)
+			return e;
+		f->live.overwrite = true;
+	}
+
+	parent = cisco_fpga_debugfs_dir(dev);
+	if (IS_ERR_OR_NULL(parent))
+		return 0;
+	dir = debugfs_create_dir("flight", parent);
+	hw->flight_dir = dir;
+	for (i = 0; i < hw->num_adapters; ++i) {
+		snprintf(name, sizeof(name), "%u", i);
+		debugfs_create_file(name, 0600, dir, &hw->flight[i], &_flight_fops);
+	}
+	return 0;
+}
+
+static const struct reg_field_value_t i2c_ext_cfg_spdCnt_values[] = {
+	REG_FIELD_VALUE(i2c_ext_cfg_spdCnt__fast, "fast"),
+	REG_FIELD_VALUE(i2c_ext_cfg_spdCnt__1Mbps, "1Mbps"),
+	REG_FIELD_VALUE(i2c_ext_cfg_spdCnt__400Kbps, "400Kbps"),
+	REG_FIELD_VALUE(i2c_ext_cfg_spdCnt__100Kbps, "100Kbps"),
+	REG_FIELD_VALUE_TERMINATOR
+};
+
+static const struct reg_field_value_t i2c_ext_cfg_dataSize_values[] = {
+	REG_FIELD_VALUE(i2c_ext_cfg_dataSize__1B, "1B"),
+	REG_FIELD_VALUE(i2c_ext_cfg_dataSize__2B, "2B"),
+	REG_FIELD_VALUE(i2c_ext_cfg_dataSize__3B, "3B"),
+	REG_FIELD_VALUE(i2c_ext_cfg_dataSize__4B, "4B"),
+	REG_FIELD_VALUE(i2c_ext_cfg_dataSize__8B_EXT, "8B ext"),
+	REG_FIELD_VALUE_TERMINATOR
+};
+
+static const struct reg_field_value_t i2c_ext_cfg_mode_values[] = {
+	REG_FIELD_VALUE(i2c_ext_cfg_mode__i2c, "i2c"),
+	REG_FIELD_VALUE(i2c_ext_cfg_mode__ext, "ext"),
+	REG_FIELD_VALUE_TERMINATOR
+};
+
+static const struct reg_field_value_t i2c_ext_cfg_accessType_values[] = {
+	REG_FIELD_VALUE(i2c_ext_cfg_accessType__seq_write, "seq write"),
+	REG_FIELD_VALUE(i2c_ext_cfg_accessType__seq_read, "seq read"),
+	REG_FIELD_VALUE(i2c_ext_cfg_accessType__cur_write, "cur write"),
+	REG_FIELD_VALUE(i2c_ext_cfg_accessType__cur_read, "cur read"),
+	REG_FIELD_VALUE_TERMINATOR
+};
+
+static const struct reg_field_layout_t i2c_ext_regs_v5_t_cfg_field_layout[] = {
+	REG_FIELD_LAYOUT(I2C_EXT_CFG_TEST, 0),
+	REG_FIELD_LAYOUT(I2C_EXT_CFG_DEVADDR, 0),
+	REG_FIELD_LAYOUT(I2C_EXT_CFG_REGADDR, 0),
+	REG_FIELD_LAYOUT(I2C_EXT_CFG_SPDCNT, i2c_ext_cfg_spdCnt_values),
+	REG_FIELD_LAYOUT(I2C_EXT_CFG_DATASIZE, i2c_ext_cfg_dataSize_values),
+	REG_FIELD_LAYOUT(I2C_EXT_CFG_DEVSEL, 0),
+	REG_FIELD_LAYOUT(I2C_EXT_CFG_MODE, i2c_ext_cfg_mode_values),
+	REG_FIELD_LAYOUT(I2C_EXT_CFG_ACCESSTYPE, i2c_ext_cfg_accessType_values),
+	REG_FIELD_LAYOUT(I2C_EXT_CFG_STARTACCESS, 0),
+	REG_FIELD_LAYOUT(I2C_EXT_CFG_RST, 0),
+	REG_FIELD_LAYOUT_TERMINATOR
+};
+
+static const struct reg_field_layout_t i2c_ext_regs_v5_t_cfg2_field_layout[] = {
+	REG_FIELD_LAYOUT(I2C_EXT_CFG2_RDATASIZE, 0),
+	REG_FIELD_LAYOUT(I2C_EXT_CFG2_WDATASIZE, 0),
+	REG_FIELD_LAYOUT_TERMINATOR
+};
+
+static const struct reg_field_layout_t i2c_ext_regs_v5_t_intSts_field_layout[] = {
+	REG_FIELD_LAYOUT(I2C_EXT_INTSTS_ERROR, 0),
+	REG_FIELD_LAYOUT(I2C_EXT_INTSTS_TIMEOUT, 0),
+	REG_FIELD_LAYOUT(I2C_EXT_INTSTS_DONE, 0),
+	REG_FIELD_LAYOUT_TERMINATOR
+};
+
+static const struct reg_field_layout_t i2c_ext_regs_v5_t_intEnb_field_layout[] = {
+	REG_FIELD_LAYOUT(I2C_EXT_INTENB_ERROR, 0),
+	REG_FIELD_LAYOUT(I2C_EXT_INTENB_TIMEOUT, 0),
+	REG_FIELD_LAYOUT(I2C_EXT_INTENB_DONE, 0),
+	REG_FIELD_LAYOUT_TERMINATOR
+};
+
+/* The data buffers are left out. */
+static const struct reg_layout_t i2c_ext_regs_v5_t_layout[] = {
+	REG_LAYOUT(I2C_EXT_CFG),
+	REG_LAYOUT(I2C_EXT_CFG2),
+	REG_LAYOUT(I2C_EXT_INTSTS),
+	REG_LAYOUT(I2C_EXT_INTENB),
+	REG_LAYOUT_TERMINATOR
+};
+
 static int
 cisco_fpga_i2c_ext_probe(struct platform_device *pdev)
 {
@@ -340,6 +755,9 @@ cisco_fpga_i2c_ext_probe(struct platform_device *pdev)
 	    .reg_stride = 4,
 	    .fast_io = false,
 	    .max_register = sizeof(struct i2c_ext_regs_v5_t) - 1,
+	    .volatile_table = &_volatile_table,
+	    .precious_table = &_precious_table,
+	    .cache_type = REGCACHE_RBTREE,
 	};
 	const struct i2c_adapter i2c_adapter_template = {
 	    .owner = THIS_MODULE,
@@ -369,6 +787,16 @@ cisco_fpga_i2c_ext_probe(struct platform_device *pdev)
 		hw->rdata_ptr = (u32 *) &rcsr->rdata_v5;
 	}
 
+	e = _flight_init(dev, hw);
+	if (e) {
+		dev_err(dev, "flight recorder init failed; status %d\n", e);
+		return e;
+	}
+
+	e = cisco_reg_layout_debugfs_init(dev, hw->regmap, i2c_ext_regs_v5_t_layout);
+	if (e)
+		dev_warn(dev, "cisco_reg_layout_debugfs_init failed; status %d\n", e);
+
 	return cisco_i2c_register(pdev, _i2c_reset);
 }
 
@@ -16,6 +16,7 @@
 #include <linux/regmap.h>
 #include <linux/gpio/consumer.h>
 
+#include "cisco/hdr.h"
 #include "cisco/i2c-arbitrate.h"
 #include "cisco/mfd.h"
 #include "cisco/util.h"
@@ -288,6 +289,28 @@ static const struct i2c_adapter_quirks _i2c_quirks = {
 	.max_comb_2nd_msg_len = 511,
 };
 
+/*
+ * Only the read-only header is cached.
+ */
+static const struct regmap_range _cached_ranges[] = {
+	CISCO_HDR_CACHED_RANGES,
+};
+
+static const struct regmap_access_table _volatile_table = {
+	.no_ranges = _cached_ranges,
+	.n_no_ranges = ARRAY_SIZE(_cached_ranges),
+};
+
+/* reading the receive buffer has side effects on a transfer in flight */
+static const struct regmap_range _precious_ranges[] = {
+	regmap_reg_range(CISCO_FPGA_I2C_RXBUF, CISCO_FPGA_I2C_RXBUF),
+};
+
+static const struct regmap_access_table _precious_table = {
+	.yes_ranges = _precious_ranges,
+	.n_yes_ranges = ARRAY_SIZE(_precious_ranges),
+};
+
 static int
 cisco_fpga_i2c_probe(struct platform_device *pdev)
 {
@@ -300,6 +323,9 @@ cisco_fpga_i2c_probe(struct platform_device *pdev)
 		.reg_stride = 4,
 		.fast_io = false,
 		.max_register = CISCO_FPG_I2C_MAX_REG_v4 - 1,
+		.volatile_table = &_volatile_table,
+		.precious_table = &_precious_table,
+		.cache_type = REGCACHE_RBTREE,
 	};
 	const struct i2c_adapter i2c_adapter_template = {
 		.owner = THIS_MODULE,
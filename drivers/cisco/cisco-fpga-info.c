@@ -110,33 +110,24 @@ static CISCO_ATTR_RO2(version, F(version), F(build));
 /*
  * sysfs file comment
  */
+static const u32 _comment_regs[] = {
+	F(comment_str[0]), F(comment_str[1]), F(comment_str[2]),
+	F(comment_str[3]), F(comment_str[4]), F(comment_str[5]),
+};
+
 static ssize_t
-comment_show(struct device *dev,
-	     struct device_attribute *attr,
-	     char *buf)
+_comment_fmt(const struct sysfs_ext_attribute *attr,
+	     char *buf, ssize_t len,
+	     const u32 *data, size_t data_dim)
 {
-	struct regmap *r = dev_get_regmap(dev, NULL);
-	size_t len = PAGE_SIZE;
-	ssize_t err = 0;
-	size_t i;
-	union {
-		char comment[24];
-		u32 data[6];
-	} u;
-
-	if (r) {
-		for (i = 0; !err && (i < ARRAY_SIZE(u.data)); i++)
-			err = regmap_read(r, F(comment_str[i]), &u.data[i]);
-		if (!err)
-			err = scnprintf(buf, len, "%.*s\n",
-					(int) sizeof(u),
-					u.comment);
-	} else {
-		err = -ENXIO;
-	}
-	return err;
+	char comment[sizeof(_comment_regs)];
+
+	BUG_ON(data_dim < ARRAY_SIZE(_comment_regs));
+
+	memcpy(comment, data, sizeof(comment));
+	return scnprintf(buf, len, "%.*s\n", (int) sizeof(comment), comment);
 }
-static DEVICE_ATTR_RO(comment);
+static CISCO_ATTR_RO_N(comment, _comment_regs);
 
 /*
  * sysfs file name
@@ -182,7 +173,7 @@ static struct attribute *_info_sys_attrs[] = {
 	&cisco_attr_fpga_id.attr.attr,
 	&cisco_attr_config_info.attr.attr,
 	&cisco_attr_version.attr.attr,
-	&dev_attr_comment.attr,
+	&cisco_attr_comment.attr.attr,
 	NULL,
 };
 static const struct attribute_group _info_attr_group = {
@@ -219,6 +210,19 @@ static const struct attribute_group *_info_attr_groups[] = {
 	NULL,
 };
 
+/*
+ * The info block is a ROM apart from the header scratch registers.
+ */
+static const struct regmap_range _volatile_ranges[] = {
+	regmap_reg_range(offsetof(struct info_regs_v6_t, hdr.sw0),
+			 offsetof(struct info_regs_v6_t, hdr.sw1)),
+};
+
+static const struct regmap_access_table _volatile_table = {
+	.yes_ranges = _volatile_ranges,
+	.n_yes_ranges = ARRAY_SIZE(_volatile_ranges),
+};
+
 static int
 cisco_fpga_info_probe(struct platform_device *pdev)
 {
@@ -230,6 +234,8 @@ cisco_fpga_info_probe(struct platform_device *pdev)
 		.reg_stride = 4,
 		.fast_io = false,
 		.max_register = sizeof(struct info_regs_v6_t) - 1,
+		.volatile_table = &_volatile_table,
+		.cache_type = REGCACHE_RBTREE,
 	};
 
 	err = cisco_fpga_mfd_init(pdev, 0, NULL, &r_config);
@@ -278,6 +284,7 @@ MODULE_DEVICE_TABLE(platform, cisco_fpga_info_id_table);
 static struct platform_driver cisco_fpga_info_driver = {
 	.driver = {
 		.name	= DRIVER_NAME,
+		.probe_type	= PROBE_PREFER_ASYNCHRONOUS,
 	},
 	.probe		= cisco_fpga_info_probe,
 	.remove		= cisco_fpga_info_remove,
@@ -130,6 +130,45 @@ static const struct attribute_group *_msd_attr_groups_v5[] = {
 	NULL,
 };
 
+static const struct reg_field_value_t msd_status0_platform_id_values[] = {
+	REG_FIELD_VALUE(msd_status0_platform_id__FIXED, "fixed"),
+	REG_FIELD_VALUE(msd_status0_platform_id__DISTRIBUTED, "distributed"),
+	REG_FIELD_VALUE(msd_status0_platform_id__CENTRAL, "central"),
+	REG_FIELD_VALUE_TERMINATOR
+};
+
+static const struct reg_field_value_t msd_cfg5_master_select_values[] = {
+	REG_FIELD_VALUE(msd_cfg5_master_select__X86, "x86"),
+	REG_FIELD_VALUE(msd_cfg5_master_select__BMC, "bmc"),
+	REG_FIELD_VALUE_TERMINATOR
+};
+
+static const struct reg_field_layout_t msd_regs_v5_t_cfg5_field_layout[] = {
+	REG_FIELD_LAYOUT(MSD_CFG5_MASTER_SELECT, msd_cfg5_master_select_values),
+	REG_FIELD_LAYOUT_TERMINATOR
+};
+
+static const struct reg_field_layout_t msd_regs_v5_t_cfg7_field_layout[] = {
+	REG_FIELD_LAYOUT(MSD_CFG7_ZONE1_CYCLE, 0),
+	REG_FIELD_LAYOUT(MSD_CFG7_ZONE1_OFF, 0),
+	REG_FIELD_LAYOUT_TERMINATOR
+};
+
+static const struct reg_field_layout_t msd_regs_v5_t_status0_field_layout[] = {
+	REG_FIELD_LAYOUT(MSD_STATUS0_PLATFORM_ID, msd_status0_platform_id_values),
+	REG_FIELD_LAYOUT(MSD_STATUS0_FPGA_ID, 0),
+	REG_FIELD_LAYOUT(MSD_STATUS0_FPGA_INSTANCE, 0),
+	REG_FIELD_LAYOUT(MSD_STATUS0_PCIE_ID, 0),
+	REG_FIELD_LAYOUT_TERMINATOR
+};
+
+static const struct reg_layout_t msd_regs_v5_t_layout[] = {
+	REG_LAYOUT(MSD_CFG5),
+	REG_LAYOUT(MSD_CFG7),
+	REG_LAYOUT(MSD_STATUS0),
+	REG_LAYOUT_TERMINATOR
+};
+
 static int cisco_fpga_msd_probe(struct platform_device *pdev)
 {
 	struct device *dev = &pdev->dev;
@@ -164,6 +203,11 @@ static int cisco_fpga_msd_probe(struct platform_device *pdev)
 		return err;
 	}
 	priv->major_ver = REG_GET(HDR_INFO0_MAJORVER, v);
+
+	err = cisco_reg_layout_debugfs_init(dev, priv->regmap, msd_regs_v5_t_layout);
+	if (err)
+		dev_warn(dev, "cisco_reg_layout_debugfs_init failed; status %d\n", err);
+
 	if (priv->major_ver >= 5)
 		err = devm_device_add_groups(dev, _msd_attr_groups_v5);
 	else
@@ -223,6 +267,7 @@ MODULE_DEVICE_TABLE(platform, cisco_fpga_msd_id_table);
 static struct platform_driver cisco_fpga_msd_driver = {
 	.driver = {
 		.name	= DRIVER_NAME,
+		.probe_type	= PROBE_PREFER_ASYNCHRONOUS,
 	},
 	.probe		= cisco_fpga_msd_probe,
 	.id_table	= cisco_fpga_msd_id_table,
@@ -224,23 +224,22 @@ _show_rails(struct cisco_fpga_pseq *priv, const u32 *datap, char *buf, size_t le
 }
 
 static int
-_read_reg(struct cisco_fpga_pseq *priv, u32 reg, u32 *data, int invert)
+_read_reg(struct device *dev, u32 reg, u32 *data, int invert)
 {
+	struct cisco_fpga_pseq *priv = dev_get_drvdata(dev);
 	struct regmap *r = priv->regmap;
+	const u32 regs[2] = { reg, reg + sizeof(u32) };
 	int e;
 
 	if (!r)
 		return -ENXIO;
 
-	e = regmap_read(r, reg, data);
-	if (invert)
-		*data = ~*data;
-
-	++data;
-	if (!e && priv->num_rails[1]) {
-		e = regmap_read(r, reg + 4, data);
-		if (invert)
-			*data = ~*data;
+	e = cisco_fpga_sysfs_read(dev, r, regs, data,
+				  priv->num_rails[1] ? 2 : 1);
+	if (!e && invert) {
+		data[0] = ~data[0];
+		if (priv->num_rails[1])
+			data[1] = ~data[1];
 	}
 	return e;
 }
@@ -255,7 +254,7 @@ power_enabled_show(struct device *dev,
 	ssize_t err;
 	u32 data[2];
 
-	err = _read_reg(priv, R(power_en0), data, 0);
+	err = _read_reg(dev, R(power_en0), data, 0);
 	if (!err)
 		err = _show_rails(priv, data, buf, len);
 
@@ -273,7 +272,7 @@ power_disabled_show(struct device *dev,
 	ssize_t err;
 	u32 data[2];
 
-	err = _read_reg(priv, R(power_en0), data, 1);
+	err = _read_reg(dev, R(power_en0), data, 1);
 	if (!err)
 		err = _show_rails(priv, data, buf, len);
 
@@ -291,7 +290,7 @@ power_good_show(struct device *dev,
 	ssize_t err;
 	u32 data[2];
 
-	err = _read_reg(priv, R(power_good0), data, 0);
+	err = _read_reg(dev, R(power_good0), data, 0);
 	if (!err)
 		err = _show_rails(priv, data, buf, len);
 
@@ -309,7 +308,7 @@ power_bad_show(struct device *dev,
 	ssize_t err;
 	u32 data[2];
 
-	err = _read_reg(priv, R(power_good0), data, 1);
+	err = _read_reg(dev, R(power_good0), data, 1);
 	if (!err)
 		err = _show_rails(priv, data, buf, len);
 
@@ -327,7 +326,7 @@ power_over_voltage_show(struct device *dev,
 	ssize_t err;
 	u32 data[2];
 
-	err = _read_reg(priv, R(power_ov0), data, 1);
+	err = _read_reg(dev, R(power_ov0), data, 1);
 	if (!err)
 		err = _show_rails(priv, data, buf, len);
 
@@ -376,6 +375,90 @@ _probe_status(struct work_struct *work)
 			 power_good, _power_state(gen_stat));
 }
 
+/*
+ * Interrupt and general configuration (and the read-only header) are
+ * cached; rail, checkpoint and interrupt status are volatile.
+ */
+static const struct regmap_range _cached_ranges[] = {
+	CISCO_HDR_CACHED_RANGES,
+	regmap_reg_range(offsetof(struct pseq_regs_v4_t, intr_cfg0),
+			 offsetof(struct pseq_regs_v4_t, gen_cfg)),
+};
+
+static const struct regmap_access_table _volatile_table = {
+	.no_ranges = _cached_ranges,
+	.n_no_ranges = ARRAY_SIZE(_cached_ranges),
+};
+
+static const struct reg_field_value_t pseq_gen_stat_power_state_values[] = {
+	REG_FIELD_VALUE(pseq_gen_stat_power_state__OFF, "off"),
+	REG_FIELD_VALUE(pseq_gen_stat_power_state__SEQUENCED_ON, "sequenced on"),
+	REG_FIELD_VALUE(pseq_gen_stat_power_state__ON, "on"),
+	REG_FIELD_VALUE(pseq_gen_stat_power_state__SEQUENCED_OFF, "sequenced off"),
+	REG_FIELD_VALUE_TERMINATOR
+};
+
+static const struct reg_field_layout_t pseq_regs_v4_t_intr_cfg0_field_layout[] = {
+	REG_FIELD_LAYOUT(PSEQ_INTR_CFG0_DATA, 0),
+	REG_FIELD_LAYOUT_TERMINATOR
+};
+
+static const struct reg_field_layout_t pseq_regs_v4_t_intr_cfg1_field_layout[] = {
+	REG_FIELD_LAYOUT(PSEQ_INTR_CFG1_MSI, 0),
+	REG_FIELD_LAYOUT_TERMINATOR
+};
+
+static const struct reg_field_layout_t pseq_regs_v4_t_gen_cfg_field_layout[] = {
+	REG_FIELD_LAYOUT(PSEQ_GEN_CFG_IGNORE_OTHER_ERR, 0),
+	REG_FIELD_LAYOUT(PSEQ_GEN_CFG_IGNORE_DEVICE_ERR, 0),
+	REG_FIELD_LAYOUT(PSEQ_GEN_CFG_IGNORE_OV, 0),
+	REG_FIELD_LAYOUT(PSEQ_GEN_CFG_USER_POWER_CYCLE, 0),
+	REG_FIELD_LAYOUT(PSEQ_GEN_CFG_USER_POWER_OFF, 0),
+	REG_FIELD_LAYOUT(PSEQ_GEN_CFG_USER_POWER_ON, 0),
+	REG_FIELD_LAYOUT(PSEQ_GEN_CFG_IGNORE_UV, 0),
+	REG_FIELD_LAYOUT_TERMINATOR
+};
+
+static const struct reg_field_layout_t pseq_regs_v4_t_gen_stat_field_layout[] = {
+	REG_FIELD_LAYOUT(PSEQ_GEN_STAT_SEQ_STATE_AT_ERR, 0),
+	REG_FIELD_LAYOUT(PSEQ_GEN_STAT_POWER_DOWN_REASON, 0),
+	REG_FIELD_LAYOUT(PSEQ_GEN_STAT_POWER_STATE, pseq_gen_stat_power_state_values),
+	REG_FIELD_LAYOUT(PSEQ_GEN_STAT_POWER_STATUS_LED, 0),
+	REG_FIELD_LAYOUT_TERMINATOR
+};
+
+static const struct reg_field_layout_t pseq_regs_v4_t_power_err0_field_layout[] = {
+	REG_FIELD_LAYOUT(PSEQ_POWER_ERR0, 0),
+	REG_FIELD_LAYOUT_TERMINATOR
+};
+
+static const struct reg_field_layout_t pseq_regs_v4_t_power_en0_field_layout[] = {
+	REG_FIELD_LAYOUT(PSEQ_POWER_EN0, 0),
+	REG_FIELD_LAYOUT_TERMINATOR
+};
+
+static const struct reg_field_layout_t pseq_regs_v4_t_power_good0_field_layout[] = {
+	REG_FIELD_LAYOUT(PSEQ_POWER_GOOD0, 0),
+	REG_FIELD_LAYOUT_TERMINATOR
+};
+
+static const struct reg_field_layout_t pseq_regs_v4_t_power_ov0_field_layout[] = {
+	REG_FIELD_LAYOUT(PSEQ_POWER_OV0, 0),
+	REG_FIELD_LAYOUT_TERMINATOR
+};
+
+static const struct reg_layout_t pseq_regs_v4_t_layout[] = {
+	REG_LAYOUT(PSEQ_INTR_CFG0),
+	REG_LAYOUT(PSEQ_INTR_CFG1),
+	REG_LAYOUT(PSEQ_GEN_CFG),
+	REG_LAYOUT(PSEQ_GEN_STAT),
+	REG_LAYOUT(PSEQ_POWER_ERR0),
+	REG_LAYOUT(PSEQ_POWER_EN0),
+	REG_LAYOUT(PSEQ_POWER_GOOD0),
+	REG_LAYOUT(PSEQ_POWER_OV0),
+	REG_LAYOUT_TERMINATOR
+};
+
 static int
 cisco_fpga_pseq_probe(struct platform_device *pdev)
 {
@@ -390,6 +473,8 @@ cisco_fpga_pseq_probe(struct platform_device *pdev)
 		.reg_stride = 4,
 		.fast_io = false,
 		.max_register = sizeof(struct pseq_regs_v4_t) - 1,
+		.volatile_table = &_volatile_table,
+		.cache_type = REGCACHE_RBTREE,
 	};
 
 	err = cisco_fpga_mfd_init(pdev, sizeof(*priv), &base, &r_config);
@@ -436,6 +521,10 @@ cisco_fpga_pseq_probe(struct platform_device *pdev)
 	if (err < 0)
 		dev_err(dev, "devm_device_add_groups failed; status %d\n", err);
 
+	err = cisco_reg_layout_debugfs_init(dev, priv->regmap, pseq_regs_v4_t_layout);
+	if (err)
+		dev_warn(dev, "cisco_reg_layout_debugfs_init failed; status %d\n", err);
+
 	if (priv->active) {
 		err = cisco_register_reboot_notifier(pdev, NULL);
 		if (err < 0)
@@ -531,6 +620,7 @@ MODULE_DEVICE_TABLE(platform, cisco_fpga_pseq_id_table);
 static struct platform_driver cisco_fpga_pseq_driver = {
 	.driver = {
 		.name	= DRIVER_NAME,
+		.probe_type	= PROBE_PREFER_ASYNCHRONOUS,
 	},
 	.probe		= cisco_fpga_pseq_probe,
 	.remove		= cisco_fpga_pseq_remove,
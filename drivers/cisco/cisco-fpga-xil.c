@@ -26,6 +26,7 @@
 #include "cisco/hdr.h"
 #include "cisco/xil.h"
 #include "cisco/mfd.h"
+#include "cisco/sysfs.h"
 #include "cisco/util.h"
 
 #define XIL_NNPUS       6
@@ -128,6 +129,7 @@ outshifts_enable_store(struct device *dev,
 		else
 			return -EINVAL;
 		e = REG_UPDATE_BITS(r, XIL_CFG1_GEN_CONF_OUTSHIFTS, cfg);
+		cisco_fpga_sysfs_cache_invalidate(dev);
 		if (e)
 			return e;
 		return consumed;
@@ -211,6 +213,7 @@ console_source_store(struct device *dev,
 		_byp(&bufp);
 		if (!*bufp) {
 			e = REG_UPDATE_BITS(r, XIL_CFG1_GEN_CONF_CONSOLE, i);
+			cisco_fpga_sysfs_cache_invalidate(dev);
 			if (!e)
 				e = bufp - buf;
 		}
@@ -517,6 +520,79 @@ _xil_sysfs_init(struct device *dev, struct xil_adapter_t *priv)
 	return err;
 }
 
+static const struct reg_field_value_t xil_status0_platform_id_values[] = {
+	REG_FIELD_VALUE(xil_status0_platform_id__FIXED, "fixed"),
+	REG_FIELD_VALUE(xil_status0_platform_id__DISTRIBUTED, "distributed"),
+	REG_FIELD_VALUE(xil_status0_platform_id__CENTRAL, "central"),
+	REG_FIELD_VALUE_TERMINATOR
+};
+
+static const struct reg_field_value_t xil_cfg1_outshifts_values[] = {
+	REG_FIELD_VALUE(xil_cfg1_outshifts__disable, "disable"),
+	REG_FIELD_VALUE(xil_cfg1_outshifts__enable, "enable"),
+	REG_FIELD_VALUE_TERMINATOR
+};
+
+static const struct reg_field_value_t xil_cfg1_console_values[] = {
+	REG_FIELD_VALUE(xil_cfg1_console__jumper, "jumper"),
+	REG_FIELD_VALUE(xil_cfg1_console__uxbar, "uxbar"),
+	REG_FIELD_VALUE_TERMINATOR
+};
+
+static const struct reg_field_value_t xil_cfg5_master_select_values[] = {
+	REG_FIELD_VALUE(xil_cfg5_master_select__X86, "x86"),
+	REG_FIELD_VALUE(xil_cfg5_master_select__BMC, "bmc"),
+	REG_FIELD_VALUE_TERMINATOR
+};
+
+static const struct reg_field_layout_t xil_regs_v5_t_cfg1_field_layout[] = {
+	REG_FIELD_LAYOUT(XIL_CFG1_GEN_CONF_CONSOLE, xil_cfg1_console_values),
+	REG_FIELD_LAYOUT(XIL_CFG1_GEN_CONF_OUTSHIFTS, xil_cfg1_outshifts_values),
+	REG_FIELD_LAYOUT_TERMINATOR
+};
+
+static const struct reg_field_layout_t xil_regs_v5_t_cfg5_field_layout[] = {
+	REG_FIELD_LAYOUT(XIL_CFG5_MASTER_SELECT, xil_cfg5_master_select_values),
+	REG_FIELD_LAYOUT_TERMINATOR
+};
+
+static const struct reg_field_layout_t xil_regs_v5_t_cfg7_field_layout[] = {
+	REG_FIELD_LAYOUT(XIL_CFG7_FPGA_WARM_RESET, 0),
+	REG_FIELD_LAYOUT(XIL_CFG7_COLD_RESET, 0),
+	REG_FIELD_LAYOUT(XIL_CFG7_CPU_WARM_RESET, 0),
+	REG_FIELD_LAYOUT(XIL_CFG7_BMC_WARM_RESET, 0),
+	REG_FIELD_LAYOUT(XIL_CFG7_BMC_CYCLE, 0),
+	REG_FIELD_LAYOUT(XIL_CFG7_CPU_CYCLE, 0),
+	REG_FIELD_LAYOUT(XIL_CFG7_CPU_ON, 0),
+	REG_FIELD_LAYOUT(XIL_CFG7_BMC_OFF, 0),
+	REG_FIELD_LAYOUT(XIL_CFG7_CPU_OFF, 0),
+	REG_FIELD_LAYOUT(XIL_CFG7_CPU_BMC_OFF, 0),
+	REG_FIELD_LAYOUT_TERMINATOR
+};
+
+static const struct reg_field_layout_t xil_regs_v5_t_status0_field_layout[] = {
+	REG_FIELD_LAYOUT(XIL_STATUS0_PLATFORM_ID, xil_status0_platform_id_values),
+	REG_FIELD_LAYOUT(XIL_STATUS0_FPGA_ID, 0),
+	REG_FIELD_LAYOUT(XIL_STATUS0_FPGA_INSTANCE, 0),
+	REG_FIELD_LAYOUT(XIL_STATUS0_PCIE_ID, 0),
+	REG_FIELD_LAYOUT_TERMINATOR
+};
+
+static const struct reg_field_layout_t xil_regs_v5_t_status1_field_layout[] = {
+	REG_FIELD_LAYOUT(XIL_STATUS1_BOARD_VER, 0),
+	REG_FIELD_LAYOUT(XIL_STATUS1_BOARD_TYPE, 0),
+	REG_FIELD_LAYOUT_TERMINATOR
+};
+
+static const struct reg_layout_t xil_regs_v5_t_layout[] = {
+	REG_LAYOUT(XIL_CFG1_GEN_CONF),
+	REG_LAYOUT(XIL_CFG5),
+	REG_LAYOUT(XIL_CFG7),
+	REG_LAYOUT(XIL_STATUS0),
+	REG_LAYOUT(XIL_STATUS1_BOARD_VER),
+	REG_LAYOUT_TERMINATOR
+};
+
 static int
 _xil_probe(struct platform_device *pdev)
 {
@@ -534,6 +610,10 @@ _xil_probe(struct platform_device *pdev)
 	if (!priv->regmap)
 		return -ENXIO;
 
+	e = cisco_reg_layout_debugfs_init(dev, priv->regmap, xil_regs_v5_t_layout);
+	if (e)
+		dev_warn(dev, "cisco_reg_layout_debugfs_init failed; status %d\n", e);
+
 	priv->csr = (typeof(priv->csr))csr;
 	if (pdev->id_entry && (pdev->id_entry->driver_data & DRIVER_DATA_OVERRIDE))
 		priv->active = pdev->id_entry->driver_data & DRIVER_DATA_ACTIVE;
@@ -618,6 +698,10 @@ cisco_fpga_xil_npu_status(struct device *npu_dev, const char *npu_name)
 		// dev_info(npu_dev, "%s: deferred for lack of %s\n", __func__, npu_name);
 		// return -EPROBE_DEFER;
 	}
+	/* unbind and suspend the NPU before its xil block */
+	if (!device_link_add(npu_dev, xil_dev, DL_FLAG_AUTOREMOVE_CONSUMER))
+		dev_warn(npu_dev, "%s: cannot link to %s\n", __func__, dev_name(xil_dev));
+
 	priv = (typeof(priv))dev_get_drvdata(xil_dev);
 	if (!priv) {
 		dev_info(xil_dev, "%s: no private data for %s\n", __func__, npu_name);
@@ -703,6 +787,7 @@ MODULE_DEVICE_TABLE(platform, cisco_fpga_xil_id_table);
 static struct platform_driver cisco_fpga_xil_driver = {
 	.driver = {
 		.name = DRIVER_NAME,
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
 	},
 	.probe    = _xil_probe,
 	.id_table = cisco_fpga_xil_id_table,
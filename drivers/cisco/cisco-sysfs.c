@@ -6,35 +6,270 @@
  * All rights reserved.
  */
 
+#include <linux/module.h>
 #include <linux/platform_device.h>
 #include <linux/regmap.h>
 #include <linux/ctype.h>
+#include <linux/jiffies.h>
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
 
 #include "cisco/reg_access.h"
 #include "cisco/sysfs.h"
 
+static unsigned int m_sysfs_ttl_ms;
+module_param(m_sysfs_ttl_ms, uint, 0644);
+MODULE_PARM_DESC(m_sysfs_ttl_ms, "Default sysfs register cache lifetime in ms. 0=none");
+
+/*
+ * Per block cache of register values read through sysfs.  Entries are
+ * keyed by their register list, so attributes reading the same registers
+ * share an entry.  The lock is held across the hardware read so that any
+ * number of concurrent readers cause at most one access per lifetime.
+ */
+struct sysfs_cache_entry {
+	struct list_head list;
+	unsigned long stamp;
+	bool valid;
+	size_t n;
+	u32 regs[SYSFS_MAX_DATA_N];
+	u32 data[SYSFS_MAX_DATA_N];
+};
+
+struct sysfs_cache {
+	struct mutex lock;
+	int ttl_ms;		/* < 0 uses m_sysfs_ttl_ms */
+	u64 hits;
+	u64 misses;
+	struct list_head entries;
+};
+
+static DEFINE_MUTEX(_sysfs_cache_lock);
+
+static void
+_sysfs_cache_release(struct device *dev, void *res)
+{
+	struct sysfs_cache *c = res;
+	struct sysfs_cache_entry *entry, *next;
+
+	list_for_each_entry_safe(entry, next, &c->entries, list)
+		kfree(entry);
+	mutex_destroy(&c->lock);
+}
+
+static struct sysfs_cache *
+_sysfs_cache(struct device *dev, bool create)
+{
+	struct sysfs_cache *c;
+
+	mutex_lock(&_sysfs_cache_lock);
+	c = devres_find(dev, _sysfs_cache_release, NULL, NULL);
+	if (!c && create) {
+		c = devres_alloc(_sysfs_cache_release, sizeof(*c), GFP_KERNEL);
+		if (c) {
+			mutex_init(&c->lock);
+			c->ttl_ms = -1;
+			INIT_LIST_HEAD(&c->entries);
+			devres_add(dev, c);
+		}
+	}
+	mutex_unlock(&_sysfs_cache_lock);
+	return c;
+}
+
+static unsigned int
+_sysfs_cache_ttl(const struct sysfs_cache *c)
+{
+	return (c && (c->ttl_ms >= 0)) ? c->ttl_ms : READ_ONCE(m_sysfs_ttl_ms);
+}
+
+/*
+ * Registers and masks of an attribute; returns the number of registers.
+ */
+static size_t
+_attr_regs(const struct sysfs_ext_attribute *attr,
+	   const u32 **regp, const u32 **maskp)
+{
+	if (attr->nregs) {
+		*regp = attr->regs;
+		*maskp = attr->masks;
+		return attr->nregs;
+	}
+	*regp = attr->reg;
+	*maskp = attr->mask;
+	return ARRAY_SIZE(attr->reg);
+}
+
+/*
+ * All registers of an attribute are read as one batch, so a run of
+ * consecutive registers is a single regmap_bulk_read().
+ */
 static int
 _regmap_read(struct regmap *r,
 	     const u32 *regp, size_t reg_dim,
 	     u32 *datap, size_t data_dim)
 {
-	const u32 *reg_limitp;
-	int err = 0;
-	u32 reg;
+	CISCO_REG_BATCH(b, r, SYSFS_MAX_DATA_N);
+	size_t index;
 
-	if ((reg_dim != data_dim) || (reg_dim < 1))
+	if ((reg_dim != data_dim) || (reg_dim < 1) ||
+	    (reg_dim > SYSFS_MAX_DATA_N))
 		return -EINVAL;
 
-	reg_limitp = regp + reg_dim;
-	for (; !err && regp != reg_limitp;) {
-		reg = *regp++;
-		if (reg != CISCO_SYSFS_REG_NOT_PRESENT)
-			err = regmap_read(r, reg, datap);
-		++datap;
+	for (index = 0; index < reg_dim; ++index) {
+		if (regp[index] != CISCO_SYSFS_REG_NOT_PRESENT)
+			cisco_reg_batch_read(&b, regp[index], &datap[index], 1);
+	}
+	return cisco_reg_batch_run(&b);
+}
+
+/*
+ * _regmap_read() through the block's cache.
+ */
+static int
+_regmap_read_cached(struct device *dev, struct regmap *r,
+		    const u32 *regp, size_t reg_dim,
+		    u32 *datap, size_t data_dim)
+{
+	struct sysfs_cache *c = _sysfs_cache(dev, false);
+	unsigned int ttl = _sysfs_cache_ttl(c);
+	struct sysfs_cache_entry *entry;
+	int err;
+
+	if (!ttl || (reg_dim > SYSFS_MAX_DATA_N) ||
+	    (!c && !(c = _sysfs_cache(dev, true))))
+		return _regmap_read(r, regp, reg_dim, datap, data_dim);
+
+	mutex_lock(&c->lock);
+	list_for_each_entry(entry, &c->entries, list) {
+		if ((entry->n == reg_dim) &&
+		    !memcmp(entry->regs, regp, reg_dim * sizeof(*regp)))
+			break;
 	}
+	if ((&entry->list != &c->entries) && entry->valid &&
+	    time_before(jiffies, entry->stamp + msecs_to_jiffies(ttl))) {
+		++c->hits;
+		memcpy(datap, entry->data, reg_dim * sizeof(*datap));
+		mutex_unlock(&c->lock);
+		return 0;
+	}
+
+	++c->misses;
+	err = _regmap_read(r, regp, reg_dim, datap, data_dim);
+	if (!err) {
+		if (&entry->list == &c->entries) {
+			entry = kzalloc(sizeof(*entry), GFP_KERNEL);
+			if (entry) {
+				entry->n = reg_dim;
+				memcpy(entry->regs, regp, reg_dim * sizeof(*regp));
+				list_add(&entry->list, &c->entries);
+			}
+		}
+		if (entry) {
+			memcpy(entry->data, datap, reg_dim * sizeof(*datap));
+			entry->stamp = jiffies;
+			entry->valid = true;
+		}
+	}
+	mutex_unlock(&c->lock);
 	return err;
 }
 
+int
+cisco_fpga_sysfs_read(struct device *dev, struct regmap *r,
+		      const u32 *regs, u32 *data, size_t dim)
+{
+	return _regmap_read_cached(dev, r, regs, dim, data, dim);
+}
+EXPORT_SYMBOL(cisco_fpga_sysfs_read);
+
+static int
+_sysfs_cache_invalidate(struct device *dev, void *data)
+{
+	struct sysfs_cache *c = _sysfs_cache(dev, false);
+	struct sysfs_cache_entry *entry;
+
+	if (!c)
+		return 0;
+
+	mutex_lock(&c->lock);
+	list_for_each_entry(entry, &c->entries, list)
+		entry->valid = false;
+	mutex_unlock(&c->lock);
+	return 0;
+}
+
+/*
+ * Children are included, as a write through the regmap shared by all
+ * blocks of an FPGA is made on behalf of the parent.
+ */
+void
+cisco_fpga_sysfs_cache_invalidate(struct device *dev)
+{
+	if (!dev)
+		return;
+	_sysfs_cache_invalidate(dev, NULL);
+	device_for_each_child(dev, NULL, _sysfs_cache_invalidate);
+}
+EXPORT_SYMBOL(cisco_fpga_sysfs_cache_invalidate);
+
+ssize_t
+cisco_fpga_sysfs_cache_show(struct device *dev,
+			    struct device_attribute *attr,
+			    char *buf)
+{
+	struct sysfs_cache *c = _sysfs_cache(dev, false);
+	u64 hits = 0, misses = 0;
+
+	if (c) {
+		mutex_lock(&c->lock);
+		hits = c->hits;
+		misses = c->misses;
+		mutex_unlock(&c->lock);
+	}
+	return scnprintf(buf, PAGE_SIZE, "ttl_ms %u\nhits %llu\nmisses %llu\n",
+			 _sysfs_cache_ttl(c),
+			 (unsigned long long)hits,
+			 (unsigned long long)misses);
+}
+EXPORT_SYMBOL(cisco_fpga_sysfs_cache_show);
+
+/*
+ *   ttl_ms <n> - keep register values read through sysfs for n ms
+ *   ttl_ms -1  - use the libcisco m_sysfs_ttl_ms default
+ *   clear      - reset the hit and miss counters
+ */
+ssize_t
+cisco_fpga_sysfs_cache_store(struct device *dev,
+			     struct device_attribute *attr,
+			     const char *buf,
+			     size_t buflen)
+{
+	struct sysfs_cache *c = _sysfs_cache(dev, true);
+	int consumed = -1;
+	int ttl;
+
+	if (!c)
+		return -ENOMEM;
+
+	if ((sscanf(buf, "ttl_ms %i %n", &ttl, &consumed) == 1) &&
+	    (consumed == buflen) && (ttl >= -1)) {
+		cisco_fpga_sysfs_cache_invalidate(dev);
+		mutex_lock(&c->lock);
+		c->ttl_ms = ttl;
+		mutex_unlock(&c->lock);
+	} else if (sysfs_streq(buf, "clear")) {
+		mutex_lock(&c->lock);
+		c->hits = c->misses = 0;
+		mutex_unlock(&c->lock);
+	} else {
+		return -EINVAL;
+	}
+	return buflen;
+}
+EXPORT_SYMBOL(cisco_fpga_sysfs_cache_store);
+
 static int
 _regmap_write(struct regmap *r,
 	      const u32 *regp, size_t reg_dim,
@@ -46,7 +281,7 @@ _regmap_write(struct regmap *r,
 	u32 reg;
 
 	if ((reg_dim != data_dim) || (reg_dim < 1) ||
-	    (reg_dim != mask_dim))
+	    (reg_dim != mask_dim) || !maskp)
 		return -EINVAL;
 
 	reg_limitp = regp + reg_dim;
@@ -73,11 +308,16 @@ _sysfs_fmt_raw(const struct sysfs_ext_attribute *attr,
 	ssize_t err = 0;
 	ssize_t wrote;
 	const char *fmt;
+	const u32 *regs, *masks;
 	u64 data64, mask;
 	u32 data32;
 
+	data_dim = min(data_dim, _attr_regs(attr, &regs, &masks));
+	if (!masks && (attr->flags & CISCO_SYSFS_ATTR_F_MASKED))
+		return -EINVAL;
+
 	for (index = 0; index < data_dim; ++index) {
-		if (attr->reg[index] == CISCO_SYSFS_REG_NOT_PRESENT)
+		if (regs[index] == CISCO_SYSFS_REG_NOT_PRESENT)
 			continue;
 		if (attr->flags & CISCO_SYSFS_ATTR_F_64) {
 			BUG_ON((index + 1) >= data_dim);
@@ -86,8 +326,8 @@ _sysfs_fmt_raw(const struct sysfs_ext_attribute *attr,
 			data64 |= data[++index];
 
 			if (attr->flags & CISCO_SYSFS_ATTR_F_MASKED) {
-				mask = (u64)attr->mask[index - 1] << 32;
-				mask |= attr->mask[index];
+				mask = (u64)masks[index - 1] << 32;
+				mask |= masks[index];
 				data64 &= mask;
 			}
 
@@ -105,7 +345,7 @@ _sysfs_fmt_raw(const struct sysfs_ext_attribute *attr,
 				fmt = "%u\n";
 
 			if (attr->flags & CISCO_SYSFS_ATTR_F_MASKED)
-				data32 &= attr->mask[index];
+				data32 &= masks[index];
 
 			wrote = snprintf(bufp, buflen, fmt, data32);
 		}
@@ -133,8 +373,10 @@ _sysfs_parse_raw(const struct sysfs_ext_attribute *attr,
 	int consumed;
 	int val;
 	ssize_t err = 0;
+	const u32 *regs, *masks;
 
-	if ((attr->reg[0] == CISCO_SYSFS_REG_NOT_PRESENT) || !data_dim || !data) {
+	_attr_regs(attr, &regs, &masks);
+	if ((regs[0] == CISCO_SYSFS_REG_NOT_PRESENT) || !data_dim || !data) {
 		err = -EINVAL;
 	} else if (sscanf(buf, "%i %n", &val, &consumed) == 1) {
 		data[0] = val;
@@ -211,7 +453,9 @@ cisco_fpga_sysfs_show(struct device *dev,
 {
 	struct sysfs_ext_attribute *attr = (typeof(attr))dattr;
 	struct regmap *r = dev_get_regmap(dev, NULL);
-	u32 data[ARRAY_SIZE(attr->reg)] = { 0 };
+	u32 data[SYSFS_MAX_DATA_N] = { 0 };
+	const u32 *regs, *masks;
+	size_t dim = _attr_regs(attr, &regs, &masks);
 	size_t buflen = PAGE_SIZE;
 	ssize_t err = 0;
 
@@ -224,14 +468,13 @@ cisco_fpga_sysfs_show(struct device *dev,
 	if (!r) {
 		err = -ENXIO;
 	} else {
-		err = _regmap_read(r, attr->reg, ARRAY_SIZE(attr->reg),
-				      data, ARRAY_SIZE(data));
+		err = _regmap_read_cached(dev, r, regs, dim, data, dim);
 		if (!err) {
 			typeof(attr->fmt_fn) fmt = attr->fmt_fn;
 
 			if (!fmt)
 				fmt = _sysfs_fmt_raw;
-			err = fmt(attr, buf, buflen, data, ARRAY_SIZE(data));
+			err = fmt(attr, buf, buflen, data, dim);
 		}
 	}
 	return err;
@@ -246,7 +489,9 @@ cisco_fpga_sysfs_store(struct device *dev,
 {
 	struct sysfs_ext_attribute *attr = (typeof(attr))dattr;
 	struct regmap *r = dev_get_regmap(dev, NULL);
-	u32 data[ARRAY_SIZE(attr->reg)] = { 0 };
+	u32 data[SYSFS_MAX_DATA_N] = { 0 };
+	const u32 *regs, *masks;
+	size_t dim = _attr_regs(attr, &regs, &masks);
 	ssize_t err = -EINVAL;
 	ssize_t consumed;
 
@@ -264,14 +509,17 @@ cisco_fpga_sysfs_store(struct device *dev,
 		if (!parse)
 			parse = _sysfs_parse_raw;
 
-		consumed = parse(attr, buf, buflen, data, ARRAY_SIZE(data));
+		if (dim > SYSFS_MAX_DATA_N)
+			return -EINVAL;
+		consumed = parse(attr, buf, buflen, data, dim);
 		if (consumed < 0) {
 			err = consumed;
 		} else if (consumed == buflen) {
 			err = _regmap_write(r,
-					    attr->reg, ARRAY_SIZE(attr->reg),
-					    attr->mask, ARRAY_SIZE(attr->mask),
-					    data, ARRAY_SIZE(data));
+					    regs, dim,
+					    masks, dim,
+					    data, dim);
+			cisco_fpga_sysfs_cache_invalidate(dev);
 			if (!err)
 				err = consumed;
 		}
@@ -316,6 +564,7 @@ cisco_fpga_sysfs_store_table(struct device *dev,
 			err = -EINVAL;
 		} else {
 			err = regmap_write(r, reg, data[0]);
+			cisco_fpga_sysfs_cache_invalidate(dev);
 			if (!err)
 				err = consumed;
 		}
@@ -12,7 +12,9 @@
 
 #include "cisco/reg_access.h"
 #include "cisco/hdr.h"
+#include "cisco/mfd.h"
 #include "cisco/sysfs.h"
+#include "cisco/util.h"
 
 static const struct reg_field_layout_t regblk_hdr_t_info0_field_layout[] = {
 	REG_FIELD_LAYOUT(HDR_INFO0_OFFSET, 0),
@@ -92,32 +94,6 @@ _version_fmt(const struct sysfs_ext_attribute *attr,
 }
 CISCO_ATTR_RO2(version, R(info0), R(info1));
 
-static int
-_regmap_read_u64(struct regmap *r, u32 reg, u64 *dst)
-{
-	u32 sw0, sw1;
-	int err = regmap_read(r, reg, &sw0);
-
-	if (!err) {
-		err = regmap_read(r, reg + 4, &sw1);
-		if (!err)
-			*dst = ((u64)sw0 << 32ull) | sw1;
-	}
-	return err;
-}
-
-static int
-_regmap_write_u64(struct regmap *r, u32 reg, u64 src)
-{
-	u32 sw0 = (src >> 32ull);
-	u32 sw1 = src; /* only low bits */
-	int err = regmap_write(r, reg, sw0);
-
-	if (!err)
-		err = regmap_write(r, reg + 4, sw1);
-	return err;
-}
-
 static ssize_t
 scratch_show(struct device *dev,
 	     struct device_attribute *attr,
@@ -134,7 +110,7 @@ scratch_show(struct device *dev,
 	if (!r && dev->parent)
 		r = dev_get_regmap(dev->parent, NULL);
 	if (r) {
-		err = _regmap_read_u64(r, R(sw0), &sw);
+		err = cisco_regmap_read_u64(r, R(sw0), R(sw1), &sw);
 		if (!err)
 			err = scnprintf(buf, len, "%#llx\n",
 					(unsigned long long) sw);
@@ -192,15 +168,11 @@ scratch_store(struct device *dev,
 		if (consumed != buflen) {
 			err = -EINVAL;
 		} else {
-			u64 data;
-
-			err = _regmap_read_u64(r, R(sw0), &data);
-			if (!err) {
-				data = ((data & and_val) ^ xor_val) | or_val;
-				err = _regmap_write_u64(r, R(sw0), data);
-				if (!err)
-					err = consumed;
-			}
+			err = cisco_regmap_update_u64(r, R(sw0), R(sw1),
+						      and_val, xor_val, or_val,
+						      NULL);
+			if (!err)
+				err = consumed;
 		}
 	} else {
 		err = -ENXIO;
@@ -209,10 +181,74 @@ scratch_store(struct device *dev,
 }
 static DEVICE_ATTR_RW(scratch);
 
+/*
+ * sysfs file regmap_mode: locking mode selected for this block's regmap
+ */
+static ssize_t
+regmap_mode_show(struct device *dev,
+		 struct device_attribute *attr,
+		 char *buf)
+{
+	return scnprintf(buf, PAGE_SIZE, "%s\n",
+			 cisco_fpga_mfd_fast_io(dev) ? "fast_io" : "sleeping");
+}
+static DEVICE_ATTR_RO(regmap_mode);
+
+/*
+ * sysfs file cache: control the block's register cache
+ *   drop   - discard all cached values; they are re-read on next access
+ *   bypass - read and write hardware directly, leaving the cache alone
+ *   enable - resume using the cache
+ */
+static ssize_t
+cache_store(struct device *dev,
+	    struct device_attribute *attr,
+	    const char *buf,
+	    size_t buflen)
+{
+	struct regmap *r = dev_get_regmap(dev, NULL);
+	int err;
+
+	if (!r)
+		return -ENXIO;
+
+	if (sysfs_streq(buf, "drop")) {
+		err = regmap_get_max_register(r);
+		if (err >= 0)
+			err = regcache_drop_region(r, 0, err);
+		cisco_fpga_sysfs_cache_invalidate(dev);
+	} else if (sysfs_streq(buf, "bypass")) {
+		regcache_cache_bypass(r, true);
+		err = 0;
+	} else if (sysfs_streq(buf, "enable")) {
+		/* writes made in bypass mode only reached the hardware */
+		err = regmap_get_max_register(r);
+		if (err >= 0)
+			regcache_drop_region(r, 0, err);
+		regcache_cache_bypass(r, false);
+		cisco_fpga_sysfs_cache_invalidate(dev);
+		err = 0;
+	} else {
+		err = -EINVAL;
+	}
+	return err ? err : buflen;
+}
+static DEVICE_ATTR_WO(cache);
+
+/*
+ * sysfs file sysfs_cache: lifetime and hit/miss counts of the
+ * block's sysfs register cache
+ */
+static DEVICE_ATTR(sysfs_cache, 0644,
+		   cisco_fpga_sysfs_cache_show, cisco_fpga_sysfs_cache_store);
+
 static struct attribute *_hdr_sys_attrs[] = {
 	&cisco_attr_block_id.attr.attr,
 	&cisco_attr_version.attr.attr,
 	&dev_attr_scratch.attr,
+	&dev_attr_regmap_mode.attr,
+	&dev_attr_cache.attr,
+	&dev_attr_sysfs_cache.attr,
 	NULL,
 };
 const struct attribute_group cisco_fpga_reghdr_attr_group = {
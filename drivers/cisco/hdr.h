@@ -40,6 +40,20 @@ struct regblk_hdr_t {
 #define HDR_MAGICNO          hdr, magicNo,      raw, 31,  0, regblk_hdr_t
 #define HDR_MAGICNO_MAGICNO  hdr, magicNo,  magicNo, 31,  0, regblk_hdr_t
 
+/*
+ * Read-only identification registers of the block header; these never
+ * change underneath the driver and may be kept in a register cache.
+ * For use in a regmap_range table.
+ */
+#define CISCO_HDR_CACHED_RANGES \
+	regmap_reg_range(offsetof(struct regblk_hdr_t, info0), \
+			 offsetof(struct regblk_hdr_t, info1)), \
+	regmap_reg_range(offsetof(struct regblk_hdr_t, magicNo), \
+			 offsetof(struct regblk_hdr_t, magicNo))
+
+struct reg_layout_t;
+
 extern const struct attribute_group cisco_fpga_reghdr_attr_group;
+extern const struct reg_layout_t *regblk_hdr_t_layout;
 
 #endif /* ndef _CISCO_HDR_H */
@@ -336,6 +336,14 @@ i2c_arbitrate(struct device *dev, struct i2c_adapter *adapter)
 #endif /* !defined(CONFIG_ACPI) */
 	}
 
+	/*
+	 * Have the driver core probe us again once the arbitration block
+	 * is bound, rather than on every deferred probe pass.
+	 */
+	if (!device_link_add(dev, hw->arb.info, DL_FLAG_AUTOPROBE_CONSUMER))
+		dev_warn(dev, "%s: cannot link to arbitration block %s\n",
+			 __func__, dev_name(hw->arb.info));
+
 	/* Ensure the arbitration block has a regmap */
 	if (!dev_get_regmap(hw->arb.info, NULL)) {
 		dev_err(hw->arb.info, "%s: waiting for regmap\n",
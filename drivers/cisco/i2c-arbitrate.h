@@ -16,6 +16,8 @@ struct platform_device;
 struct attribute_group;
 struct regmap;
 struct regmap_config;
+struct i2c_ext_flight;
+struct dentry;
 
 struct cisco_i2c_arbitrate {
 	u32	peer;		/* peer scratch register */
@@ -65,6 +67,9 @@ struct cisco_fpga_i2c {
 	/* i2c_ext specific */
 	u32 *rdata_ptr;
 	u16 bufsize;
+	struct i2c_ext_flight *flight;		/* per adapter */
+	struct i2c_ext_flight *flight_cur;	/* adapter in transfer */
+	struct dentry *flight_dir;
 
 	struct i2c_adapter adap[0];	/* dynamic */
 };
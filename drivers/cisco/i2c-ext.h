@@ -84,7 +84,8 @@ enum i2c_ext_cfg_accessType {
 #define I2C_EXT_CFG_STARTACCESS i2c_ext, cfg, startAccess,  1,  1, i2c_ext_regs_v5_t
 #define I2C_EXT_CFG_RST         i2c_ext, cfg,         rst,  0,  0, i2c_ext_regs_v5_t
 
-#define I2C_EXT_CFG2_RDATASIZE i2c_ext, cfg, RdataSize, 26, 16, i2c_ext_regs_v5_t
-#define I2C_EXT_CFG2_WDATASIZE i2c_ext, cfg, WdataSize, 9,   0, i2c_ext_regs_v5_t
+#define I2C_EXT_CFG2           i2c_ext, cfg2,       raw, 31,  0, i2c_ext_regs_v5_t
+#define I2C_EXT_CFG2_RDATASIZE i2c_ext, cfg2, RdataSize, 26, 16, i2c_ext_regs_v5_t
+#define I2C_EXT_CFG2_WDATASIZE i2c_ext, cfg2, WdataSize, 9,   0, i2c_ext_regs_v5_t
 
 #endif /* ndef CISCO_8000_I2C_EXT_H_ */
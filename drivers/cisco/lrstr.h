@@ -96,4 +96,17 @@ struct lrstr_regs_v4_t {
 #define LRSTR_INTDIS_TIMER_ROLLOVER lrstr,  IntDis, timer_rollover,  1,  1, lrstr_regs_v4_t
 #define LRSTR_INTDIS_TIMER_WRITE    lrstr,  IntDis,    timer_write,  0,  0, lrstr_regs_v4_t
 
+/*
+ * The timer rolls over into days; read both without tearing.
+ * Result is days in the high and timer in the low 32 bits.
+ */
+#define LRSTR_READ_DAYS_TIMER(_r, _dst) \
+	cisco_regmap_read_u64_consistent((_r), \
+					 offsetof(struct lrstr_regs_v4_t, days), \
+					 offsetof(struct lrstr_regs_v4_t, timer), \
+					 (_dst))
+
+struct reg_layout_t;
+extern const struct reg_layout_t *lrstr_regs_v4_t_layout;
+
 #endif /* ndef CISCO_8000_LRSTR_H_ */
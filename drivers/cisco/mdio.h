@@ -87,4 +87,7 @@ enum mdio_cfg_accessType {
 #define MDIO_DONEINTDIS         mdio,  doneIntDis,     raw, 31,  0, mdio_regs_v4_t
 #define MDIO_DONEINTDIS_DONEIE  mdio,  doneIntDis,  doneIe,  0,  0, mdio_regs_v4_t
 
+struct reg_layout_t;
+extern const struct reg_layout_t *mdio_regs_v4_t_layout;
+
 #endif /* ndef CISCO_8000_MDIO_H_ */
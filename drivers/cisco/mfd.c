@@ -17,10 +17,21 @@
 #include <linux/acpi.h>
 #include <linux/regmap.h>
 #include <linux/version.h>
+#include <linux/crc32.h>
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/platform_device.h>
 
 #include <cisco/mfd.h>
 #include <cisco/fpga.h>
 #include <cisco/hdr.h>
+#include <cisco/reg_access.h>
+#include <cisco/reg_trace.h>
+#include <cisco/sysfs.h>
+#include <cisco/util.h>
+#include <cisco/xil.h>
 
 #define IGNORE_UNKNOWN_CHILDREN 0
 
@@ -269,16 +280,43 @@ static const struct cisco_fpga_blk {
 
 static const struct cisco_fpga_blk _irq_blk = { 38, "intr", 0, 0, 0 };
 
+/*
+ * 1 + index of the first cisco_fpga_blks entry for each block id, and
+ * index of the first catch-all (id 0) entry.  Entries of an id are
+ * adjacent in the table.
+ */
+static u8 cisco_fpga_blk_index[256];
+static u8 cisco_fpga_blk_default;
+
+void
+cisco_fpga_mfd_blk_index_init(void)
+{
+	const struct cisco_fpga_blk *blk;
+	u8 i;
+
+	BUILD_BUG_ON(ARRAY_SIZE(cisco_fpga_blks) >= U8_MAX);
+
+	for (i = 0, blk = cisco_fpga_blks; blk->id; ++i, ++blk) {
+		if (!cisco_fpga_blk_index[blk->id])
+			cisco_fpga_blk_index[blk->id] = i + 1;
+	}
+	cisco_fpga_blk_default = i;
+}
+
 static const struct cisco_fpga_blk *
 cisco_fpga_blk_match(int id, u32 filter, struct cisco_fpga_blk *scratch)
 {
-	const struct cisco_fpga_blk *blk = cisco_fpga_blks;
+	const struct cisco_fpga_blk *blk;
+	u8 i = ((id > 0) && (id < ARRAY_SIZE(cisco_fpga_blk_index)))
+		? cisco_fpga_blk_index[id] : 0;
 
-	while (blk->id) {
-		if ((blk->id == id) && (blk->filter & filter))
-			return blk;
-		blk++;
+	if (i) {
+		for (blk = &cisco_fpga_blks[i - 1]; blk->id == id; ++blk) {
+			if (blk->filter & filter)
+				return blk;
+		}
 	}
+	blk = &cisco_fpga_blks[cisco_fpga_blk_default];
 	while (blk->filter) {
 		if (blk->filter & filter)
 			break;
@@ -412,38 +450,239 @@ _fwnode_config(struct cell_metadata *meta,
 static int
 _blkread(struct regmap *r, size_t reg, void *vdst, size_t len)
 {
-	u32 *dst = vdst;
-	int e = 0;
+	CISCO_REG_BATCH(b, r, 1);
 
 	if (len & 3)
 		return -EINVAL;
+	if (!len)
+		return 0;
 
-	while (len && !e) {
-		e = regmap_read(r, reg, dst);
-		reg += 4;
-		++dst;
-		len -= 4;
-	}
+	cisco_reg_batch_read(&b, reg, vdst, len / 4);
+	return cisco_reg_batch_run(&b);
+}
 
-	return e;
+/*
+ * Only the identity words and magic of a header are needed to enumerate;
+ * skipping sw[] saves two register reads per block.
+ */
+static int
+_blkhdr_read(struct regmap *r, u32 absoff, struct blkhdr *hdr)
+{
+	CISCO_REG_BATCH(b, r, 2);
+	u32 w[sizeof(*hdr) / sizeof(u32)] = { 0 };
+	int err;
+
+	BUILD_BUG_ON(offsetof(struct blkhdr, magic) != 4 * sizeof(u32));
+
+	cisco_reg_batch_read(&b, absoff, &w[0], 2);
+	cisco_reg_batch_read(&b, absoff + offsetof(struct blkhdr, magic),
+			     &w[4], 1);
+	err = cisco_reg_batch_run(&b);
+	if (!err)
+		memcpy(hdr, w, sizeof(*hdr));
+	return err;
 }
 
+/*
+ * Read the headers of all blocks once, up to and including the tail
+ * block; returns the number read.
+ */
 static int
-_setup_max_irqs(struct device *dev, struct regmap *r,
-				struct cell_metadata *meta, struct info_rom *info, u32 debug)
+_blkhdrs_read(struct regmap *r, struct cell_metadata *meta,
+	      const struct info_rom *info, struct blkhdr *hdrs)
 {
 	u32 absoff = 0;
 	u32 nxtoff = 0;
 	int err;
-	struct blkhdr hdr;
+	int i;
 
-	for (int i = 0; i < info->num_blocks; i++) {
+	for (i = 0; i < info->num_blocks; i++) {
 		absoff = nxtoff;
 		nxtoff = absoff + (meta->block_offset[i] << 8);
 
-		err = _blkread(r, absoff, &hdr, sizeof(hdr));
+		if (!i) {
+			hdrs[i] = info->hdr;
+			continue;
+		}
+		err = _blkhdr_read(r, absoff, &hdrs[i]);
 		if (err)
 			return err;
+		if ((hdrs[i].magic == CISCO_FPGA_MAGIC) && (hdrs[i].id == 255))
+			return i + 1;
+	}
+	return i;
+}
+
+/*
+ * Topology cache: the block headers of each FPGA build seen since
+ * libcisco was loaded, so that re-probing an FPGA (driver reload,
+ * line card restart) does not walk every block again.  The key is the
+ * info_rom identity plus a checksum of the info_rom and of the block
+ * offset table; a hit is confirmed by re-reading two headers.
+ */
+static bool m_topology_cache = true;
+module_param(m_topology_cache, bool, 0644);
+MODULE_PARM_DESC(m_topology_cache, "Reuse block headers of known FPGA builds. 0=always scan");
+
+#define TOPOLOGY_CACHE_MAX 16
+
+struct topology_key {
+	u32 magic;
+	u32 id;
+	u32 version;
+	u32 build;
+	u32 num_blocks;
+	u32 csum;
+};
+
+struct topology_entry {
+	struct list_head list;
+	struct topology_key key;
+	int nhdrs;
+	struct blkhdr hdrs[];
+};
+
+static LIST_HEAD(_topology_cache);
+static DEFINE_MUTEX(_topology_lock);
+static u32 _topology_entries;
+
+static void
+_topology_key(const struct info_rom *info, const struct cell_metadata *meta,
+	      struct topology_key *key)
+{
+	struct info_rom ident = *info;
+
+	/* sw[] is scratch and changes at run time */
+	ident.hdr.sw[0] = ident.hdr.sw[1] = 0;
+
+	key->magic = info->hdr.magic;
+	key->id = info->fpga_id;
+	key->version = (info->rev_maj << 24) | (info->rev_min << 8) | info->rev_dbg;
+	key->build = info->build;
+	key->num_blocks = info->num_blocks;
+	key->csum = crc32(~0, (const u8 *)&ident, sizeof(ident));
+	key->csum = crc32(key->csum, (const u8 *)meta->block_offset,
+			  info->num_blocks * sizeof(meta->block_offset[0]));
+}
+
+static u32
+_blk_absoff(const struct cell_metadata *meta, int index)
+{
+	u32 absoff = 0;
+	int i;
+
+	for (i = 0; i < index; ++i)
+		absoff += meta->block_offset[i] << 8;
+	return absoff;
+}
+
+static bool
+_topology_spot_check(struct regmap *r, const struct cell_metadata *meta,
+		     const struct blkhdr *hdrs, int nhdrs)
+{
+	int check[] = { nhdrs / 2, nhdrs - 1 };
+	struct blkhdr hdr;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(check); ++i) {
+		if (check[i] < 1)
+			continue;
+		if (_blkhdr_read(r, _blk_absoff(meta, check[i]), &hdr) ||
+		    (hdr.magic != hdrs[check[i]].magic) ||
+		    memcmp(&hdr, &hdrs[check[i]], offsetof(struct blkhdr, sw)))
+			return false;
+	}
+	return true;
+}
+
+/*
+ * Returns the number of headers copied from the cache, or 0 on a miss.
+ */
+static int
+_topology_lookup(struct regmap *r, const struct cell_metadata *meta,
+		 const struct topology_key *key, struct blkhdr *hdrs)
+{
+	struct topology_entry *t;
+	int nhdrs = 0;
+
+	if (!m_topology_cache)
+		return 0;
+
+	mutex_lock(&_topology_lock);
+	list_for_each_entry(t, &_topology_cache, list) {
+		if (!memcmp(&t->key, key, sizeof(*key))) {
+			nhdrs = t->nhdrs;
+			memcpy(hdrs, t->hdrs, nhdrs * sizeof(*hdrs));
+			list_move(&t->list, &_topology_cache);
+			break;
+		}
+	}
+	mutex_unlock(&_topology_lock);
+
+	if (nhdrs && !_topology_spot_check(r, meta, hdrs, nhdrs))
+		nhdrs = 0;
+	return nhdrs;
+}
+
+static void
+_topology_store(const struct topology_key *key,
+		const struct blkhdr *hdrs, int nhdrs)
+{
+	struct topology_entry *t, *old = NULL;
+
+	if (!m_topology_cache)
+		return;
+
+	t = kmalloc(struct_size(t, hdrs, nhdrs), GFP_KERNEL);
+	if (!t)
+		return;
+	t->key = *key;
+	t->nhdrs = nhdrs;
+	memcpy(t->hdrs, hdrs, nhdrs * sizeof(*hdrs));
+
+	mutex_lock(&_topology_lock);
+	list_for_each_entry(old, &_topology_cache, list) {
+		if (!memcmp(&old->key, key, sizeof(*key)))
+			break;
+	}
+	if (&old->list == &_topology_cache) {
+		old = NULL;
+		if (_topology_entries >= TOPOLOGY_CACHE_MAX)
+			old = list_last_entry(&_topology_cache,
+					      struct topology_entry, list);
+		else
+			++_topology_entries;
+	}
+	if (old)
+		list_del(&old->list);
+	list_add(&t->list, &_topology_cache);
+	mutex_unlock(&_topology_lock);
+
+	kfree(old);
+}
+
+void
+cisco_fpga_mfd_topology_flush(void)
+{
+	struct topology_entry *t, *next;
+
+	mutex_lock(&_topology_lock);
+	list_for_each_entry_safe(t, next, &_topology_cache, list) {
+		list_del(&t->list);
+		kfree(t);
+	}
+	_topology_entries = 0;
+	mutex_unlock(&_topology_lock);
+}
+
+static int
+_setup_max_irqs(struct device *dev, const struct blkhdr *hdrs, int nhdrs,
+				struct cell_metadata *meta, struct info_rom *info, u32 debug)
+{
+	const struct blkhdr *hdr;
+
+	for (int i = 0; i < nhdrs; i++) {
+		hdr = &hdrs[i];
 
 		if (info->hdr.magic != CISCO_FPGA_MAGIC) {
 			if (debug & 1)
@@ -451,16 +690,16 @@ _setup_max_irqs(struct device *dev, struct regmap *r,
 								info->hdr.magic, CISCO_FPGA_MAGIC);
 			return -ENODEV;
 		}
-		if (hdr.id == 255) /* tail block */
+		if (hdr->id == 255) /* tail block */
 			break;
 
-		if (hdr.id == 38) { /* interrupt block */
-			if (hdr.maj < 8)
+		if (hdr->id == 38) { /* interrupt block */
+			if (hdr->maj < 8)
 				meta->max_irqs = CISCO_FPGA_MAX_IRQS_LT_V8;
 			else
 				meta->max_irqs = CISCO_FPGA_MAX_IRQS_V8;
 			dev_info(dev, "max_irqs = %u (v%d.%d cell %u)",
-						meta->max_irqs, hdr.maj, hdr.minorVer, hdr.id);
+						meta->max_irqs, hdr->maj, hdr->minorVer, hdr->id);
 			return 0;
 		}
 	}
@@ -472,11 +711,191 @@ _setup_max_irqs(struct device *dev, struct regmap *r,
 	return 0;
 }
 
-struct cell_metadata *
-cisco_fpga_mfd_cells(struct device *dev, struct regmap *r,
-						const struct resource *resource_template,
-						void *pdata, size_t pdata_size,
-						u32 filter, u32 debug)
+/*
+ * Identity of the FPGA and of its blocks, captured while the blocks are
+ * enumerated and served from memory by the sysfs file inventory.
+ */
+struct inventory_blk {
+	u32 offset;
+	u8 id;
+	u8 maj;
+	u8 min;
+	u8 fpga;
+	u8 inst;
+	u8 have_dna;
+	const char *name;
+	u64 dna;
+};
+
+struct inventory {
+	u16 vendor;
+	u16 family;
+	u32 fpga_id;
+	u32 cfg_info;
+	u32 rev_maj;
+	u32 rev_min;
+	u32 rev_dbg;
+	u32 build;
+	char comment[24];
+	s64 enum_us;
+	bool cached;
+	u32 nblks;
+	u32 max_blks;
+	struct inventory_blk blk[];
+};
+
+/*
+ * The device holds its current inventory through one devres entry, added
+ * before the sysfs file, so that the file is gone before the inventory
+ * is freed.  A rescan swaps the inventory under _inventory_lock.
+ */
+struct inventory_holder {
+	struct inventory *inv;
+};
+
+static DEFINE_MUTEX(_inventory_lock);
+
+static void
+_inventory_release(struct device *dev, void *res)
+{
+	struct inventory_holder *h = res;
+
+	kfree(h->inv);
+}
+
+/* called with _inventory_lock held */
+static struct inventory *
+_inventory_get(struct device *dev)
+{
+	struct inventory_holder *h;
+
+	h = devres_find(dev, _inventory_release, NULL, NULL);
+	return h ? h->inv : NULL;
+}
+
+static struct inventory_blk *
+_inventory_blk(struct inventory *inv, const char *name, u32 offset,
+	       const struct blkhdr *hdr)
+{
+	struct inventory_blk *b;
+
+	if (!inv || (inv->nblks >= inv->max_blks))
+		return NULL;
+
+	b = &inv->blk[inv->nblks++];
+	b->offset = offset;
+	b->id = hdr->id;
+	b->maj = hdr->maj;
+	b->min = hdr->minorVer;
+	b->fpga = hdr->fpgaNum;
+	b->inst = hdr->instNum;
+	b->name = name;
+	return b;
+}
+
+static ssize_t
+inventory_show(struct device *dev,
+	       struct device_attribute *attr,
+	       char *buf)
+{
+	const struct inventory *inv;
+	const struct inventory_blk *b;
+	ssize_t len = 0;
+	u32 i;
+
+	mutex_lock(&_inventory_lock);
+	inv = _inventory_get(dev);
+	if (!inv) {
+		mutex_unlock(&_inventory_lock);
+		return -ENODEV;
+	}
+	len += scnprintf(buf + len, PAGE_SIZE - len,
+			 "info:\n"
+			 "  vendor: %#x\n"
+			 "  family: %u\n"
+			 "  id: %#x\n"
+			 "  config_info: %#x\n"
+			 "  version: %u.%u.%u-%u\n"
+			 "  comment: \"%.*s\"\n"
+			 "  enumeration_us: %lld\n"
+			 "  topology: %s\n"
+			 "blocks:\n",
+			 inv->vendor, inv->family, inv->fpga_id, inv->cfg_info,
+			 inv->rev_maj, inv->rev_min, inv->rev_dbg, inv->build,
+			 (int)sizeof(inv->comment),
+			 inv->comment, (long long)inv->enum_us,
+			 inv->cached ? "cached" : "scanned");
+	for (i = 0, b = inv->blk; i < inv->nblks; ++i, ++b) {
+		len += scnprintf(buf + len, PAGE_SIZE - len,
+				 "  - { offset: %#x, id: %u, name: %s, version: %u.%u, fpga: %u, inst: %u",
+				 b->offset, b->id, b->name ? b->name : "unknown",
+				 b->maj, b->min, b->fpga, b->inst);
+		if (b->have_dna)
+			len += scnprintf(buf + len, PAGE_SIZE - len,
+					 ", dna: %#llx",
+					 (unsigned long long)b->dna);
+		len += scnprintf(buf + len, PAGE_SIZE - len, " }\n");
+	}
+	mutex_unlock(&_inventory_lock);
+	return len;
+}
+static DEVICE_ATTR_RO(inventory);
+
+static void
+_inventory_remove(void *data)
+{
+	struct device *dev = data;
+
+	device_remove_file(dev, &dev_attr_inventory);
+}
+
+/*
+ * Replaces the inventory of an earlier enumeration, if any.
+ */
+static void
+_inventory_publish(struct device *dev, struct inventory *inv)
+{
+	struct inventory_holder *h;
+	struct inventory *old = NULL;
+	bool first = false;
+	int e;
+
+	mutex_lock(&_inventory_lock);
+	h = devres_find(dev, _inventory_release, NULL, NULL);
+	if (!h) {
+		h = devres_alloc(_inventory_release, sizeof(*h), GFP_KERNEL);
+		if (h) {
+			devres_add(dev, h);
+			first = true;
+		}
+	}
+	if (h) {
+		old = h->inv;
+		h->inv = inv;
+	} else {
+		old = inv;
+	}
+	mutex_unlock(&_inventory_lock);
+	kfree(old);
+
+	if (first) {
+		e = device_create_file(dev, &dev_attr_inventory);
+		if (!e)
+			e = devm_add_action_or_reset(dev, _inventory_remove, dev);
+		if (e)
+			dev_warn(dev, "inventory failed; status %d\n", e);
+	}
+}
+
+/*
+ * With rescan set the topology cache is bypassed and the inventory is
+ * handed back through invp instead of being published.
+ */
+static struct cell_metadata *
+_mfd_cells(struct device *dev, struct regmap *r,
+	   const struct resource *resource_template,
+	   void *pdata, size_t pdata_size,
+	   u32 filter, u32 debug, bool rescan, struct inventory **invp)
 {
 	struct info_rom info;
 	int err;
@@ -487,6 +906,14 @@ cisco_fpga_mfd_cells(struct device *dev, struct regmap *r,
 	int i;
 	u8 info_ver;
 	struct cell_metadata *meta;
+	struct inventory *inv;
+	struct inventory_blk *inv_blk;
+	struct blkhdr *hdrs;
+	int nhdrs;
+	struct topology_key key;
+	bool cached;
+	ktime_t start = ktime_get();
+	s64 elapsed_us;
 
 	err = _blkread(r, absoff, &info, sizeof(info));
 	if (err)
@@ -507,6 +934,12 @@ cisco_fpga_mfd_cells(struct device *dev, struct regmap *r,
 		 */
 		info.num_blocks = ARRAY_SIZE(meta->block_offset) - 1;
 	}
+	/* num_blocks sizes the reads and allocations below */
+	if (info.num_blocks >= ARRAY_SIZE(meta->block_offset)) {
+		if (debug & 1)
+			dev_err(dev, "bad num_blocks %u\n", info.num_blocks);
+		return ERR_PTR(-EINVAL);
+	}
 
 	meta = _init_metadata(dev, info.num_blocks, resource_template,
 								pdata, pdata_size, debug);
@@ -517,9 +950,10 @@ cisco_fpga_mfd_cells(struct device *dev, struct regmap *r,
 								info.rev_dbg, info.build);
 
 	if (info_ver >= 6) {
+		/* only the entries in use */
 		err = _blkread(r, offsetof(struct info_rom, block_offset),
 								meta->block_offset,
-								sizeof(meta->block_offset));
+								ALIGN(info.num_blocks * sizeof(u16), 4));
 		if (err) {
 			kfree(meta);
 			return ERR_PTR(err);
@@ -540,12 +974,47 @@ cisco_fpga_mfd_cells(struct device *dev, struct regmap *r,
 		return ERR_PTR(-ENXIO);
 	}
 
-	err = _setup_max_irqs(dev, r, meta, &info, debug);
+	hdrs = kcalloc(info.num_blocks, sizeof(*hdrs), GFP_KERNEL);
+	if (!hdrs) {
+		kfree(meta);
+		return ERR_PTR(-ENOMEM);
+	}
+	_topology_key(&info, meta, &key);
+	nhdrs = rescan ? 0 : _topology_lookup(r, meta, &key, hdrs);
+	cached = nhdrs > 0;
+	if (!cached) {
+		nhdrs = _blkhdrs_read(r, meta, &info, hdrs);
+		if (nhdrs < 0) {
+			kfree(hdrs);
+			kfree(meta);
+			return ERR_PTR(nhdrs);
+		}
+		_topology_store(&key, hdrs, nhdrs);
+	}
+
+	err = _setup_max_irqs(dev, hdrs, nhdrs, meta, &info, debug);
 	if (err) {
+		kfree(hdrs);
 		kfree(meta);
 		return ERR_PTR(err);
 	}
 
+	/* the inventory is optional; carry on without one */
+	inv = kzalloc(struct_size(inv, blk, info.num_blocks), GFP_KERNEL);
+	if (inv) {
+		inv->vendor = info.vendor;
+		inv->family = info.family;
+		inv->fpga_id = info.fpga_id;
+		inv->cfg_info = info.cfg_info;
+		inv->rev_maj = info.rev_maj;
+		inv->rev_min = info.rev_min;
+		inv->rev_dbg = info.rev_dbg;
+		inv->build = info.build;
+		memcpy(inv->comment, info.comment, sizeof(inv->comment));
+		inv->max_blks = info.num_blocks;
+		_inventory_blk(inv, blk->name, 0, &info.hdr);
+	}
+
 	nxtoff = absoff + (meta->block_offset[0] << 8);
 	(void)_fwnode_config(meta, blk, 0, nxtoff, blk->id);
 
@@ -553,15 +1022,10 @@ cisco_fpga_mfd_cells(struct device *dev, struct regmap *r,
 	 * Build an MFD cell per block.
 	 * Start at 1 because we have already processed the info_rom block above.
 	 */
-	for (i = 1; i < info.num_blocks; i++) {
+	for (i = 1; i < nhdrs; i++) {
 		absoff = nxtoff;
 		nxtoff = absoff + (meta->block_offset[i] << 8);
-
-		err = _blkread(r, absoff, &hdr, sizeof(hdr));
-		if (err) {
-			kfree(meta);
-			return ERR_PTR(err);
-		}
+		hdr = hdrs[i];
 
 		if (hdr.magic != CISCO_FPGA_MAGIC) {
 			if (info_ver >= 6) {
@@ -582,12 +1046,23 @@ cisco_fpga_mfd_cells(struct device *dev, struct regmap *r,
 		}
 
 		if (hdr.id == 38) { /* interrupt block */
+			_inventory_blk(inv, _irq_blk.name, absoff, &hdr);
 			(void)_fwnode_config(meta, &_irq_blk, absoff, nxtoff, hdr.id);
 			continue;
 		}
 
 		/* regular block */
 		blk = cisco_fpga_blk_match(hdr.id, filter, &scratch);
+		inv_blk = _inventory_blk(inv, blk->name, absoff, &hdr);
+		if (inv_blk && (hdr.id == 57)) { /* xil */
+			u32 dna[2];
+
+			if (!_blkread(r, absoff + offsetof(struct xil_regs_v5_t, dev_dna_msw),
+				      dna, sizeof(dna))) {
+				inv_blk->dna = ((u64)dna[0] << 32) | dna[1];
+				inv_blk->have_dna = 1;
+			}
+		}
 		if (!blk->name || _fwnode_config(meta, blk, absoff, nxtoff, hdr.id)) {
 			/*
 			 * Explicitly ignore this block. Generally used when we
@@ -646,6 +1121,21 @@ cisco_fpga_mfd_cells(struct device *dev, struct regmap *r,
 		}
 	}
 
+	kfree(hdrs);
+
+	elapsed_us = ktime_us_delta(ktime_get(), start);
+	meta->dev_msg(dev, "enumerated %u blocks in %lld us%s\n",
+		      nhdrs, (long long)elapsed_us,
+		      cached ? " (cached topology)" : "");
+	if (inv) {
+		inv->enum_us = elapsed_us;
+		inv->cached = cached;
+	}
+	if (invp)
+		*invp = inv;
+	else if (inv)
+		_inventory_publish(dev, inv);
+
 	if (debug & 8) {
 		struct mfd_cell *cell = meta->cells;
 
@@ -659,8 +1149,771 @@ cisco_fpga_mfd_cells(struct device *dev, struct regmap *r,
 
 	return meta;
 }
+
+struct cell_metadata *
+cisco_fpga_mfd_cells(struct device *dev, struct regmap *r,
+						const struct resource *resource_template,
+						void *pdata, size_t pdata_size,
+						u32 filter, u32 debug)
+{
+	return _mfd_cells(dev, r, resource_template, pdata, pdata_size,
+			  filter, debug, false, NULL);
+}
 EXPORT_SYMBOL(cisco_fpga_mfd_cells);
 
+/*
+ * Link loss.  A PCIe FPGA which dropped off the bus, or a card which was
+ * pulled, reads as all ones.  The first such read whose block header
+ * magic number also reads as all ones marks the parent's link lost;
+ * from then on every block fails its accesses with -ENODEV instead of
+ * polling until a timeout.  Writing "recover" to the parent's sysfs file
+ * link, or a successful rescan, clears the state; if the FPGA is still
+ * gone the next access marks it lost again.
+ */
+#define LINK_MAGIC_REG	offsetof(struct regblk_hdr_t, magicNo)
+
+static void
+_link_event(struct work_struct *work)
+{
+	struct cisco_fpga_mfd *mfd = container_of(work, struct cisco_fpga_mfd,
+						  link_work);
+	char *envp[] = {
+		cisco_fpga_mfd_link_lost(mfd) ? "CISCO_FPGA_LINK=lost"
+					      : "CISCO_FPGA_LINK=up",
+		NULL,
+	};
+
+	sysfs_notify(&mfd->dev->kobj, NULL, "link");
+	kobject_uevent_env(&mfd->dev->kobj, KOBJ_CHANGE, envp);
+}
+
+static void
+_link_changed(struct cisco_fpga_mfd *mfd)
+{
+	if (mfd->dev)
+		schedule_work(&mfd->link_work);
+}
+
+int
+cisco_fpga_mfd_link_verify(struct cisco_fpga_mfd *mfd, struct device *dev,
+			   unsigned int reg,
+			   int (*read)(void *context, unsigned int reg,
+				       unsigned int *val),
+			   void *context)
+{
+	unsigned int magic = U32_MAX;
+
+	/* a failed read of the magic number is not a live link either */
+	if ((reg != LINK_MAGIC_REG) &&
+	    !read(context, LINK_MAGIC_REG, &magic) && (magic != U32_MAX))
+		return 0;
+
+	if (!test_and_set_bit(CISCO_FPGA_MFD_LINK_LOST, &mfd->link_state)) {
+		atomic_inc(&mfd->link_losses);
+		dev_err(dev, "link lost; reg %#x read all ones\n", reg);
+		_link_changed(mfd);
+	}
+	return -ENODEV;
+}
+EXPORT_SYMBOL(cisco_fpga_mfd_link_verify);
+
+static void
+_link_up(struct cisco_fpga_mfd *mfd)
+{
+	if (test_and_clear_bit(CISCO_FPGA_MFD_LINK_LOST, &mfd->link_state)) {
+		dev_info(mfd->dev, "link recovered\n");
+		_link_changed(mfd);
+	}
+}
+
+static ssize_t
+link_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct cisco_fpga_mfd *mfd = dev_get_drvdata(dev);
+
+	return scnprintf(buf, PAGE_SIZE, "%s losses %d\n",
+			 cisco_fpga_mfd_link_lost(mfd) ? "lost" : "up",
+			 atomic_read(&mfd->link_losses));
+}
+
+static ssize_t
+link_store(struct device *dev, struct device_attribute *attr,
+	   const char *buf, size_t count)
+{
+	struct cisco_fpga_mfd *mfd = dev_get_drvdata(dev);
+
+	if (!sysfs_streq(buf, "recover"))
+		return -EINVAL;
+	_link_up(mfd);
+	return count;
+}
+static DEVICE_ATTR_RW(link);
+
+static void
+_link_remove(void *data)
+{
+	struct cisco_fpga_mfd *mfd = data;
+
+	device_remove_file(mfd->dev, &dev_attr_link);
+	cancel_work_sync(&mfd->link_work);
+}
+
+static void
+_link_init(struct device *dev, struct cisco_fpga_mfd *mfd)
+{
+	int e;
+
+	mfd->link_state = 0;
+	atomic_set(&mfd->link_losses, 0);
+	INIT_WORK(&mfd->link_work, _link_event);
+
+	/* without mfd->dev no events are queued */
+	mfd->dev = NULL;
+	e = device_create_file(dev, &dev_attr_link);
+	if (!e) {
+		mfd->dev = dev;
+		e = devm_add_action_or_reset(dev, _link_remove, mfd);
+		if (e)
+			mfd->dev = NULL;
+	}
+	if (e)
+		dev_warn(dev, "link state failed; status %d\n", e);
+}
+
+/*
+ * Live re-enumeration, for an FPGA reprogrammed in the field.
+ *
+ * The block table is re-read, bypassing the topology cache, and compared
+ * with the inventory of the previous enumeration.  Children whose block is
+ * gone or whose header changed are unregistered, cells for new or changed
+ * blocks are added, and all other children stay bound.
+ *
+ * Cells are added one at a time, since mfd_add_devices() removes every
+ * child of the parent when it fails part way.  On failure the cells added
+ * so far are removed and the removed children are re-added from copies
+ * taken before they were unregistered, and the old inventory is kept.
+ *
+ * Only parents which add their cells without an irq domain (the BMC) are
+ * supported; the irq resources of a removed child are re-used as is.
+ */
+struct rescan_old {
+	struct mfd_cell cell;
+	struct mfd_cell_acpi_match match;
+	char name[PLATFORM_NAME_SIZE];
+	struct resource *res;
+};
+
+struct rescan {
+	const struct inventory *old_inv;
+	const struct inventory *new_inv;
+	const struct cell_metadata *meta;
+	bool *keep;
+	struct platform_device **gone;
+	u32 ngone;
+	u32 nchildren;
+};
+
+static DEFINE_MUTEX(_rescan_lock);
+
+static const struct inventory_blk *
+_inventory_find(const struct inventory *inv, u32 offset)
+{
+	u32 i;
+
+	for (i = 0; i < inv->nblks; ++i)
+		if (inv->blk[i].offset == offset)
+			return &inv->blk[i];
+	return NULL;
+}
+
+static bool
+_rescan_same_blk(const struct rescan *rs, u32 offset)
+{
+	const struct inventory_blk *a = _inventory_find(rs->old_inv, offset);
+	const struct inventory_blk *b = _inventory_find(rs->new_inv, offset);
+
+	return a && b && (a->id == b->id) && (a->maj == b->maj) &&
+	       (a->min == b->min);
+}
+
+static struct platform_device *
+_rescan_cell_pdev(struct device *dev)
+{
+	struct platform_device *pdev;
+
+	if (!dev_is_platform(dev))
+		return NULL;
+	pdev = to_platform_device(dev);
+	return pdev->mfd_cell ? pdev : NULL;
+}
+
+static int
+_rescan_count(struct device *dev, void *data)
+{
+	struct rescan *rs = data;
+
+	if (_rescan_cell_pdev(dev))
+		++rs->nchildren;
+	return 0;
+}
+
+static int
+_rescan_child(struct device *dev, void *data)
+{
+	struct rescan *rs = data;
+	struct platform_device *pdev = _rescan_cell_pdev(dev);
+	struct resource *res;
+	u32 i;
+
+	if (!pdev)
+		return 0;
+
+	res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
+	if (res && _rescan_same_blk(rs, res->start)) {
+		for (i = 0; i < rs->meta->ncells; ++i) {
+			const struct mfd_cell *cell = &rs->meta->cells[i];
+
+			/* a block that grew or shrank is a changed cell */
+			if (!rs->keep[i] &&
+			    (cell->resources[0].start == res->start) &&
+			    (cell->resources[0].end == res->end) &&
+			    !strcmp(cell->name, pdev->name)) {
+				rs->keep[i] = true;
+				return 0;
+			}
+		}
+	}
+	if (rs->ngone >= rs->nchildren)
+		return -ENOSPC;
+	get_device(dev);
+	rs->gone[rs->ngone++] = pdev;
+	return 0;
+}
+
+/*
+ * A kept cell's regmap cache describes the FPGA before it was
+ * reprogrammed.  The cache is dropped rather than synced, as syncing
+ * would write the old header back.
+ */
+static int
+_rescan_refresh(struct device *dev, void *data)
+{
+	struct regmap *r;
+	int max_reg;
+
+	if (!_rescan_cell_pdev(dev))
+		return 0;
+	r = dev_get_regmap(dev, NULL);
+	if (r) {
+		max_reg = regmap_get_max_register(r);
+		if (max_reg >= 0)
+			regcache_drop_region(r, 0, max_reg);
+	}
+	return 0;
+}
+
+static int
+_rescan_match(struct device *dev, void *data)
+{
+	const struct mfd_cell *cell = data;
+	struct platform_device *pdev = _rescan_cell_pdev(dev);
+	struct resource *res;
+
+	if (!pdev || strcmp(pdev->name, cell->name))
+		return 0;
+	res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
+	return res && (res->start == cell->resources[0].start);
+}
+
+static int
+_rescan_save(struct platform_device *pdev, struct rescan_old *old)
+{
+	u32 i;
+
+	old->res = kcalloc(pdev->num_resources, sizeof(*old->res), GFP_KERNEL);
+	if (!old->res)
+		return -ENOMEM;
+	for (i = 0; i < pdev->num_resources; ++i) {
+		old->res[i].start = pdev->resource[i].start;
+		old->res[i].end = pdev->resource[i].end;
+		old->res[i].flags = pdev->resource[i].flags;
+		old->res[i].name = pdev->resource[i].name;
+	}
+	strscpy(old->name, pdev->name, sizeof(old->name));
+
+	/* name, resources and acpi_match pointed into the freed metadata */
+	old->cell = *pdev->mfd_cell;
+	old->cell.name = old->name;
+	old->cell.resources = old->res;
+	old->cell.num_resources = pdev->num_resources;
+	old->match.adr = old->res[0].start;
+	old->cell.acpi_match = &old->match;
+	return 0;
+}
+
+static void
+_rescan_unregister(struct device *dev, const struct mfd_cell *cell)
+{
+	struct device *child;
+
+	child = device_find_child(dev, (void *)cell, _rescan_match);
+	if (child) {
+		platform_device_unregister(to_platform_device(child));
+		put_device(child);
+	}
+}
+
+int
+cisco_fpga_mfd_rescan(struct device *dev, struct regmap *r,
+		      const struct resource *resource_template,
+		      void *pdata, size_t pdata_size,
+		      u32 filter, u32 debug)
+{
+	struct rescan rs = { 0 };
+	struct cell_metadata *meta = NULL;
+	struct inventory *inv = NULL;
+	struct rescan_old *old = NULL;
+	struct cisco_fpga_mfd *mfd;
+	u32 i, nsaved = 0, nadded = 0, nkept = 0;
+	int e, e2;
+
+	if (dev_of_node(dev))
+		return -EOPNOTSUPP;
+
+	mutex_lock(&_rescan_lock);
+
+	/* only a rescan replaces it, and _rescan_lock is held */
+	mutex_lock(&_inventory_lock);
+	rs.old_inv = _inventory_get(dev);
+	mutex_unlock(&_inventory_lock);
+	if (!rs.old_inv) {
+		e = -ENODEV;
+		goto out;
+	}
+
+	meta = _mfd_cells(dev, r, resource_template, pdata, pdata_size,
+			  filter, debug, true, &inv);
+	if (IS_ERR(meta)) {
+		e = PTR_ERR(meta);
+		meta = NULL;
+		goto out;
+	}
+	if (!inv) {
+		e = -ENOMEM;
+		goto out;
+	}
+	rs.new_inv = inv;
+	rs.meta = meta;
+
+	/* the FPGA answered with a valid block table */
+	mfd = dev_get_drvdata(dev);
+	if (mfd && (mfd->magic == &cisco_fpga_mfd_magic))
+		_link_up(mfd);
+
+	device_for_each_child(dev, &rs, _rescan_count);
+	rs.keep = kcalloc(meta->ncells, sizeof(*rs.keep), GFP_KERNEL);
+	rs.gone = kcalloc(rs.nchildren, sizeof(*rs.gone), GFP_KERNEL);
+	old = kcalloc(rs.nchildren, sizeof(*old), GFP_KERNEL);
+	if ((meta->ncells && !rs.keep) || (rs.nchildren && (!rs.gone || !old))) {
+		e = -ENOMEM;
+		goto out;
+	}
+
+	/* nothing is touched until every copy needed for rollback is taken */
+	e = device_for_each_child(dev, &rs, _rescan_child);
+	for (i = 0; !e && (i < rs.ngone); ++i, ++nsaved)
+		e = _rescan_save(rs.gone[i], &old[i]);
+	if (e)
+		goto out;
+
+	for (i = 0; i < rs.ngone; ++i)
+		platform_device_unregister(rs.gone[i]);
+
+	/* whatever happens below, kept cells see the reprogrammed FPGA */
+	device_for_each_child(dev, NULL, _rescan_refresh);
+	cisco_fpga_sysfs_cache_invalidate(dev);
+
+	for (i = 0; i < meta->ncells; ++i) {
+		if (rs.keep[i]) {
+			++nkept;
+			continue;
+		}
+		e = mfd_add_devices(dev, 0, &meta->cells[i], 1, NULL, 0, NULL);
+		if (e)
+			break;
+		++nadded;
+	}
+
+	if (e) {
+		dev_err(dev, "rescan: adding %s failed; status %d; rolling back\n",
+			meta->cells[i].name, e);
+		while (i--)
+			if (!rs.keep[i])
+				_rescan_unregister(dev, &meta->cells[i]);
+		for (i = 0; i < rs.ngone; ++i) {
+			e2 = mfd_add_devices(dev, 0, &old[i].cell, 1, NULL, 0, NULL);
+			if (e2)
+				dev_err(dev, "rescan: restoring %s failed; status %d\n",
+					old[i].name, e2);
+		}
+		goto out;
+	}
+
+	dev_info(dev, "rescan: %u removed, %u added, %u unchanged\n",
+		 rs.ngone, nadded, nkept);
+	_inventory_publish(dev, inv);
+	inv = NULL;
+
+out:
+	mutex_unlock(&_rescan_lock);
+
+	for (i = 0; i < rs.ngone; ++i)
+		put_device(&rs.gone[i]->dev);
+	for (i = 0; i < nsaved; ++i)
+		kfree(old[i].res);
+	kfree(old);
+	kfree(rs.gone);
+	kfree(rs.keep);
+	kfree(inv);
+	kfree(meta);
+	return e;
+}
+EXPORT_SYMBOL(cisco_fpga_mfd_rescan);
+
+static struct cisco_fpga_mfd *
+_parent_mfd(struct device *dev)
+{
+	struct device *parent = dev->parent;
+	struct cisco_fpga_mfd *mfd = parent ? dev_get_drvdata(parent) : NULL;
+
+	if (!mfd || (mfd->magic != &cisco_fpga_mfd_magic))
+		return NULL;
+	return mfd;
+}
+
+bool
+cisco_fpga_mfd_fast_io(struct device *dev)
+{
+	struct cisco_fpga_mfd *mfd = _parent_mfd(dev);
+
+	return mfd && (mfd->flags & CISCO_FPGA_MFD_F_MMIO);
+}
+EXPORT_SYMBOL(cisco_fpga_mfd_fast_io);
+
+/*
+ * Probe statistics of MFD children, from platform bus notifications.
+ * A deferred probe shows up as a failed attempt that is retried.  Only
+ * children of parents registered by cisco_fpga_mfd_parent_init() are
+ * counted; the drvdata of other parents is never looked at.
+ */
+struct probe_parent {
+	struct list_head list;
+	struct device *dev;
+};
+
+struct probe_stat {
+	struct list_head list;
+	struct device *dev;
+	struct device *parent;
+	ktime_t start;
+	u32 attempts;
+	u32 failed;
+	s64 last_us;
+	s64 total_us;
+	bool bound;
+};
+
+static LIST_HEAD(_probe_parents);
+static LIST_HEAD(_probe_stats);
+static DEFINE_MUTEX(_probe_stats_lock);
+
+static bool
+_probe_parent_known(struct device *dev)
+{
+	struct probe_parent *pp;
+
+	list_for_each_entry(pp, &_probe_parents, list) {
+		if (pp->dev == dev)
+			return true;
+	}
+	return false;
+}
+
+static void
+_probe_parent_release(void *data)
+{
+	struct probe_parent *pp = data;
+	struct probe_stat *ps, *next;
+
+	mutex_lock(&_probe_stats_lock);
+	list_del(&pp->list);
+	list_for_each_entry_safe(ps, next, &_probe_stats, list) {
+		if (ps->parent == pp->dev) {
+			list_del(&ps->list);
+			kfree(ps);
+		}
+	}
+	mutex_unlock(&_probe_stats_lock);
+	kfree(pp);
+}
+
+/* statistics are optional; carry on without them */
+static void
+_probe_parent_add(struct device *dev)
+{
+	struct probe_parent *pp = kzalloc(sizeof(*pp), GFP_KERNEL);
+
+	if (!pp)
+		return;
+	pp->dev = dev;
+	mutex_lock(&_probe_stats_lock);
+	list_add_tail(&pp->list, &_probe_parents);
+	mutex_unlock(&_probe_stats_lock);
+	if (devm_add_action_or_reset(dev, _probe_parent_release, pp))
+		dev_dbg(dev, "probe statistics unavailable\n");
+}
+
+static struct probe_stat *
+_probe_stat(struct device *dev, bool create)
+{
+	struct probe_stat *ps;
+
+	list_for_each_entry(ps, &_probe_stats, list) {
+		if (ps->dev == dev)
+			return ps;
+	}
+	if (!create)
+		return NULL;
+	ps = kzalloc(sizeof(*ps), GFP_KERNEL);
+	if (ps) {
+		ps->dev = dev;
+		ps->parent = dev->parent;
+		list_add_tail(&ps->list, &_probe_stats);
+	}
+	return ps;
+}
+
+static int
+_probe_notify(struct notifier_block *nb, unsigned long action, void *data)
+{
+	struct device *dev = data;
+	struct probe_stat *ps;
+
+	if (!dev_is_platform(dev) || !to_platform_device(dev)->mfd_cell ||
+	    !dev->parent)
+		return NOTIFY_DONE;
+
+	mutex_lock(&_probe_stats_lock);
+	if (!_probe_parent_known(dev->parent)) {
+		mutex_unlock(&_probe_stats_lock);
+		return NOTIFY_DONE;
+	}
+	ps = _probe_stat(dev, action == BUS_NOTIFY_BIND_DRIVER);
+	if (ps) {
+		switch (action) {
+		case BUS_NOTIFY_BIND_DRIVER:
+			ps->start = ktime_get();
+			++ps->attempts;
+			break;
+
+		case BUS_NOTIFY_BOUND_DRIVER:
+		case BUS_NOTIFY_DRIVER_NOT_BOUND:
+			ps->last_us = ktime_us_delta(ktime_get(), ps->start);
+			ps->total_us += ps->last_us;
+			ps->bound = action == BUS_NOTIFY_BOUND_DRIVER;
+			if (!ps->bound)
+				++ps->failed;
+			break;
+
+		case BUS_NOTIFY_UNBOUND_DRIVER:
+			ps->bound = false;
+			break;
+
+		case BUS_NOTIFY_DEL_DEVICE:
+			list_del(&ps->list);
+			kfree(ps);
+			break;
+		}
+	}
+	mutex_unlock(&_probe_stats_lock);
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block _probe_nb = {
+	.notifier_call = _probe_notify,
+};
+
+static int
+_probe_stats_show(struct seq_file *m, void *v)
+{
+	struct probe_stat *ps;
+
+	mutex_lock(&_probe_stats_lock);
+	list_for_each_entry(ps, &_probe_stats, list) {
+		seq_printf(m, "%s %s attempts %u failed %u last_us %lld total_us %lld %s\n",
+			   dev_name(ps->dev->parent), dev_name(ps->dev),
+			   ps->attempts, ps->failed,
+			   (long long)ps->last_us, (long long)ps->total_us,
+			   ps->bound ? "bound" : "unbound");
+	}
+	mutex_unlock(&_probe_stats_lock);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(_probe_stats);
+
+int
+cisco_fpga_mfd_probe_stats_init(struct dentry *root)
+{
+	debugfs_create_file("probe_stats", 0400, root, NULL, &_probe_stats_fops);
+	return bus_register_notifier(&platform_bus_type, &_probe_nb);
+}
+
+void
+cisco_fpga_mfd_probe_stats_exit(void)
+{
+	struct probe_stat *ps, *next;
+
+	bus_unregister_notifier(&platform_bus_type, &_probe_nb);
+	mutex_lock(&_probe_stats_lock);
+	list_for_each_entry_safe(ps, next, &_probe_stats, list) {
+		list_del(&ps->list);
+		kfree(ps);
+	}
+	mutex_unlock(&_probe_stats_lock);
+}
+
+/*
+ * A child window on the regmap shared by the parent.  The child regmap
+ * keeps its own cache, access tables and max_register, but locks with
+ * the shared regmap's lock and forwards accesses to the shared transport
+ * at the offset of the child's block.
+ */
+struct window_regmap {
+	struct device *dev;
+	struct cisco_fpga_mfd *mfd;
+	struct regmap *shared;
+	u32 base;
+	u32 size;
+};
+
+static void
+_window_lock(void *arg)
+{
+	cisco_regmap_lock(arg);
+}
+
+static void
+_window_unlock(void *arg)
+{
+	cisco_regmap_unlock(arg);
+}
+
+static int
+_window_read(void *context, unsigned int reg, unsigned int *val)
+{
+	struct window_regmap *w = context;
+	int e = -EINVAL;
+
+	if (cisco_fpga_mfd_link_lost(w->mfd))
+		return -ENODEV;
+	if (reg < w->size)
+		e = cisco_regmap_read_locked(w->shared, w->base + reg, val);
+	reg_trace_access(w->dev, REG_TRACE_OP_READ,
+			 (const void __iomem *)(uintptr_t)(w->base + reg),
+			 e ? 0 : *val, e);
+	if (!e)
+		e = cisco_fpga_mfd_link_check(w->mfd, w->dev, reg, *val,
+					      _window_read, w);
+	return e;
+}
+
+static int
+_window_write(void *context, unsigned int reg, unsigned int val)
+{
+	struct window_regmap *w = context;
+	int e = -EINVAL;
+
+	if (cisco_fpga_mfd_link_lost(w->mfd))
+		return -ENODEV;
+	if (reg < w->size)
+		e = cisco_regmap_write_locked(w->shared, w->base + reg, val);
+	reg_trace_access(w->dev, REG_TRACE_OP_WRITE,
+			 (const void __iomem *)(uintptr_t)(w->base + reg),
+			 val, e);
+	return e;
+}
+
+static const struct regmap_config _window_regmap_config = {
+	.reg_bits = 32,
+	.val_bits = 32,
+	.reg_stride = 4,
+};
+
+static int
+_window_regmap(struct platform_device *pdev, struct cisco_fpga_mfd *mfd,
+	       size_t priv_size, uintptr_t *base,
+	       const struct regmap_config *r_configp)
+{
+	struct device *dev = &pdev->dev;
+	struct resource *res;
+	struct window_regmap *priv;
+	struct regmap *r;
+	struct regmap_config regmap_config =
+		r_configp ? *r_configp : _window_regmap_config;
+
+	res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
+	if (!res || (resource_size(res) < 4))
+		return -ENXIO;
+
+	priv = devm_kzalloc(dev, sizeof(*priv) + priv_size, GFP_KERNEL);
+	if (!priv)
+		return -ENOMEM;
+
+	if (priv_size)
+		platform_set_drvdata(pdev, &priv[1]);
+	else
+		platform_set_drvdata(pdev, NULL);
+
+	priv->dev = dev;
+	priv->mfd = mfd;
+	priv->shared = mfd->shared;
+	priv->base = res->start;
+	priv->size = resource_size(res);
+
+	regmap_config.reg_read = _window_read;
+	regmap_config.reg_write = _window_write;
+	regmap_config.disable_locking = false;
+	regmap_config.lock = _window_lock;
+	regmap_config.unlock = _window_unlock;
+	regmap_config.lock_arg = mfd->shared;
+	if (!regmap_config.max_register ||
+	    (regmap_config.max_register >= priv->size))
+		regmap_config.max_register = priv->size - 4;
+
+	r = devm_regmap_init(dev, NULL, priv, &regmap_config);
+	if (IS_ERR(r))
+		return PTR_ERR(r);
+
+	if (base)
+		*base = priv->base;
+
+	return 0;
+}
+
+/*
+ * The regmap shared by all blocks of the FPGA, addressed by absolute
+ * offset, so that batches may cross block boundaries; NULL unless the
+ * parent of dev shares one.
+ */
+struct regmap *
+cisco_fpga_mfd_shared_regmap(struct device *dev)
+{
+	struct cisco_fpga_mfd *mfd = _parent_mfd(dev);
+
+	return mfd ? mfd->shared : NULL;
+}
+EXPORT_SYMBOL(cisco_fpga_mfd_shared_regmap);
+
 int
 cisco_fpga_mfd_init(struct platform_device *pdev, size_t priv_size,
 					uintptr_t *base, const struct regmap_config *r_configp)
@@ -668,6 +1921,8 @@ cisco_fpga_mfd_init(struct platform_device *pdev, size_t priv_size,
 	struct device *dev = &pdev->dev;
 	struct device *parent = dev->parent;
 	struct cisco_fpga_mfd *mfd = parent ? dev_get_drvdata(parent) : NULL;
+	struct regmap_config r_config;
+	uintptr_t csr = 0;
 	int e = -ENODEV;
 
 	if (!parent)
@@ -681,8 +1936,48 @@ cisco_fpga_mfd_init(struct platform_device *pdev, size_t priv_size,
 	else if (!mfd->init_regmap)
 		dev_err(dev, "%s has no regmap initialization function\n",
 						dev_name(dev->parent));
-	else
-		e = mfd->init_regmap(pdev, priv_size, base, r_configp);
+	else {
+		/*
+		 * The locking mode is a property of the parent transport,
+		 * not of the child; override whatever the child asked for.
+		 * regcache_rbtree allocates nodes under the regmap lock with
+		 * GFP_KERNEL, which must not happen under the fast_io
+		 * spinlock; memory mapped registers are cheap to read anyway.
+		 */
+		if (r_configp) {
+			r_config = *r_configp;
+			r_config.fast_io = !!(mfd->flags & CISCO_FPGA_MFD_F_MMIO);
+			if (r_config.fast_io)
+				r_config.cache_type = REGCACHE_NONE;
+			r_configp = &r_config;
+		}
+		if (mfd->shared)
+			e = _window_regmap(pdev, mfd, priv_size,
+					   &csr, r_configp);
+		else
+			e = mfd->init_regmap(pdev, priv_size, &csr, r_configp);
+		if (base)
+			*base = csr;
+		if (!e) {
+			dev_dbg(dev, "%s regmap\n",
+				mfd->shared ? "shared" :
+				(mfd->flags & CISCO_FPGA_MFD_F_MMIO)
+					? "fast_io" : "sleeping");
+
+			/* tracing is a debug aid; do not fail the probe */
+			if (reg_trace_debugfs_init(dev, csr))
+				dev_dbg(dev, "register tracing unavailable\n");
+
+			if (cisco_reg_batch_debugfs_init(dev, dev_get_regmap(dev, NULL)))
+				dev_dbg(dev, "register batch file unavailable\n");
+
+			e = cisco_fpga_regs_sysfs_init(dev);
+			if (e) {
+				dev_warn(dev, "regs snapshot failed; status %d\n", e);
+				e = 0;
+			}
+		}
+	}
 
 	return e;
 }
@@ -701,5 +1996,114 @@ cisco_fpga_mfd_parent_init(struct device *dev, struct cisco_fpga_mfd *init,
 
 	init->magic = &cisco_fpga_mfd_magic;
 	init->init_regmap = init_regmap;
+	init->flags = 0;
+	init->shared = NULL;
+	_link_init(dev, init);
+	_probe_parent_add(dev);
 }
 EXPORT_SYMBOL(cisco_fpga_mfd_parent_init);
+
+/*
+ * Passed to regmap callbacks in child of a memory mapped parent
+ */
+struct mmio_regmap {
+	struct device *dev;
+	struct cisco_fpga_mfd *mfd;
+	void __iomem *csr;
+};
+
+static int
+_mmio_read(void *context, unsigned int reg, unsigned int *val)
+{
+	struct mmio_regmap *m = context;
+
+	if (cisco_fpga_mfd_link_lost(m->mfd))
+		return -ENODEV;
+	*val = reg_read32(m->dev, m->csr + reg);
+	return cisco_fpga_mfd_link_check(m->mfd, m->dev, reg, *val,
+					 _mmio_read, m);
+}
+
+static int
+_mmio_write(void *context, unsigned int reg, unsigned int val)
+{
+	struct mmio_regmap *m = context;
+
+	if (cisco_fpga_mfd_link_lost(m->mfd))
+		return -ENODEV;
+	reg_write32(m->dev, val, m->csr + reg);
+	return 0;
+}
+
+static const struct regmap_config _mmio_regmap_config = {
+	.reg_bits = 32,
+	.val_bits = 32,
+	.reg_stride = 4,
+	.reg_read = _mmio_read,
+	.reg_write = _mmio_write,
+	.fast_io = true,
+};
+
+static int
+_mmio_regmap(struct platform_device *pdev, size_t priv_size, uintptr_t *base,
+					const struct regmap_config *r_configp)
+{
+	struct device *dev = &pdev->dev;
+	struct resource *res;
+	struct mmio_regmap *priv;
+	struct regmap *r;
+	struct regmap_config regmap_config =
+		r_configp ? *r_configp : _mmio_regmap_config;
+
+	regmap_config.reg_read = _mmio_read;
+	regmap_config.reg_write = _mmio_write;
+
+	res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
+	if (!res)
+		return -ENXIO;
+
+	priv = devm_kzalloc(dev, sizeof(*priv) + priv_size, GFP_KERNEL);
+	if (!priv)
+		return -ENOMEM;
+
+	/* The parent owns the region; map without requesting it again. */
+	priv->csr = devm_ioremap(dev, res->start, resource_size(res));
+	if (!priv->csr)
+		return -ENOMEM;
+	priv->dev = dev;
+	priv->mfd = _parent_mfd(dev);
+
+	if (priv_size)
+		platform_set_drvdata(pdev, &priv[1]);
+	else
+		platform_set_drvdata(pdev, NULL);
+
+	r = devm_regmap_init(dev, NULL, priv, &regmap_config);
+	if (IS_ERR(r))
+		return PTR_ERR(r);
+
+	if (base)
+		*base = (uintptr_t)priv->csr;
+
+	return 0;
+}
+
+void
+cisco_fpga_mfd_mmio_parent_init(struct device *dev, struct cisco_fpga_mfd *init)
+{
+	cisco_fpga_mfd_parent_init(dev, init, _mmio_regmap);
+	init->flags |= CISCO_FPGA_MFD_F_MMIO;
+}
+EXPORT_SYMBOL(cisco_fpga_mfd_mmio_parent_init);
+
+/*
+ * Children get windows on r, which covers the whole FPGA, instead of a
+ * regmap of their own from init_regmap.  r must outlive the children.
+ */
+void
+cisco_fpga_mfd_shared_parent_init(struct cisco_fpga_mfd *init,
+				  struct regmap *r)
+{
+	init->shared = r;
+}
+EXPORT_SYMBOL(cisco_fpga_mfd_shared_parent_init);
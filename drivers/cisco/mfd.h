@@ -12,12 +12,15 @@
 #include <linux/kernel.h>     /* __iomem */
 #include <linux/device.h>
 #include <linux/acpi.h>
+#include <linux/workqueue.h>
+#include <linux/atomic.h>
 
 struct resource;
 struct mfd_cell;
 struct mfd_cell_acpi_match;
 struct regmap;
 struct regmap_config;
+struct dentry;
 
 /*
  * This structure is passed in the parent of MFD cells.
@@ -28,8 +31,27 @@ struct cisco_fpga_mfd {
 	int (*init_regmap)(struct platform_device *pdev, size_t priv_size,
 			   uintptr_t *base,
 			   const struct regmap_config *r_configp);
+	u32 flags;
+	struct regmap *shared;
+
+	/* link loss; see cisco_fpga_mfd_link_check() */
+	struct device *dev;
+	unsigned long link_state;
+	atomic_t link_losses;
+	struct work_struct link_work;
 };
 
+#define CISCO_FPGA_MFD_LINK_LOST             0
+
+/*
+ * Parent capabilities (cisco_fpga_mfd.flags)
+ *
+ * CISCO_FPGA_MFD_F_MMIO: child register blocks are memory mapped, so the
+ * child regmaps are created with fast_io (spinlock) and may be used from
+ * atomic context.  Without it children get a sleeping (mutex) regmap.
+ */
+#define CISCO_FPGA_MFD_F_MMIO                0x1
+
 struct child_metadata {
 	unsigned long long	adr;
 	int			id;
@@ -70,6 +92,20 @@ cisco_fpga_mfd_cells(struct device *dev, struct regmap *r,
 		     const struct resource *resource_template,
 		     void *pdata, size_t pdata_size,
 		     u32 filter, u32 debug);
+extern int
+cisco_fpga_mfd_rescan(struct device *dev, struct regmap *r,
+		      const struct resource *resource_template,
+		      void *pdata, size_t pdata_size,
+		      u32 filter, u32 debug);
+
+extern void
+cisco_fpga_mfd_blk_index_init(void);
+extern void
+cisco_fpga_mfd_topology_flush(void);
+extern int
+cisco_fpga_mfd_probe_stats_init(struct dentry *root);
+extern void
+cisco_fpga_mfd_probe_stats_exit(void);
 
 extern int
 cisco_fpga_mfd_init(struct platform_device *pdev, size_t priv_size,
@@ -83,4 +119,51 @@ cisco_fpga_mfd_parent_init(struct device *dev,
 					      size_t priv_size, uintptr_t *base,
 					      const struct regmap_config *r_configp));
 
+extern void
+cisco_fpga_mfd_mmio_parent_init(struct device *dev,
+				struct cisco_fpga_mfd *init);
+
+extern void
+cisco_fpga_mfd_shared_parent_init(struct cisco_fpga_mfd *init,
+				  struct regmap *r);
+
+extern bool
+cisco_fpga_mfd_fast_io(struct device *dev);
+
+extern struct regmap *
+cisco_fpga_mfd_shared_regmap(struct device *dev);
+
+extern int
+cisco_fpga_mfd_link_verify(struct cisco_fpga_mfd *mfd, struct device *dev,
+			   unsigned int reg,
+			   int (*read)(void *context, unsigned int reg,
+				       unsigned int *val),
+			   void *context);
+
+/*
+ * Once the parent's link is lost, accesses of every block fail at once.
+ */
+static inline bool
+cisco_fpga_mfd_link_lost(struct cisco_fpga_mfd *mfd)
+{
+	return mfd && test_bit(CISCO_FPGA_MFD_LINK_LOST, &mfd->link_state);
+}
+
+/*
+ * Called by regmap read callbacks with the value just read; reads all
+ * ones are checked against the magic number of the block header, which
+ * read() must return relative to the same block.
+ */
+static inline int
+cisco_fpga_mfd_link_check(struct cisco_fpga_mfd *mfd, struct device *dev,
+			  unsigned int reg, unsigned int val,
+			  int (*read)(void *context, unsigned int reg,
+				      unsigned int *val),
+			  void *context)
+{
+	if (likely(val != U32_MAX) || !mfd)
+		return 0;
+	return cisco_fpga_mfd_link_verify(mfd, dev, reg, read, context);
+}
+
 #endif /* ndef CISCO_MFD_H_ */
@@ -41,6 +41,34 @@ _precious_reg(struct device *dev, unsigned int reg)
 	return b;
 }
 
+/*
+ * Registers only the host writes, and that do not change on their own,
+ * are cached, plus the read-only header.  Everything else is volatile:
+ * status, interrupt, scratch and dna registers, cfg5, whose
+ * master_select the BMC writes too, cfg6, and cfg7, whose reset and
+ * power bits clear themselves.  msd has no intrCfg registers; the
+ * offsets are padding there.
+ */
+#define _CACHED_REG(_r) \
+	regmap_reg_range(offsetof(struct xil_regs_t, _r), \
+			 offsetof(struct xil_regs_t, _r))
+
+static const struct regmap_range _cached_ranges[] = {
+	CISCO_HDR_CACHED_RANGES,
+	_CACHED_REG(intrCfg0),
+	_CACHED_REG(intrCfg1),
+	_CACHED_REG(cfg0),
+	_CACHED_REG(cfg1),
+	_CACHED_REG(cfg2),
+	_CACHED_REG(cfg3),
+	_CACHED_REG(cfg4),
+};
+
+static const struct regmap_access_table _volatile_table = {
+	.no_ranges = _cached_ranges,
+	.n_no_ranges = ARRAY_SIZE(_cached_ranges),
+};
+
 int
 cisco_fpga_msd_xil_mfd_init(struct platform_device *pdev,
 			    size_t priv_size,
@@ -53,6 +81,8 @@ cisco_fpga_msd_xil_mfd_init(struct platform_device *pdev,
 		.fast_io = false,
 		.max_register = sizeof(struct xil_regs_t) - 1,
 		.precious_reg = _precious_reg,
+		.volatile_table = &_volatile_table,
+		.cache_type = REGCACHE_RBTREE,
 	};
 
 	return cisco_fpga_mfd_init(pdev, priv_size, csr, &r_config);
@@ -126,6 +126,7 @@ _scratch_store_bit(struct device *dev,
 					e = -EAGAIN;
 				} else if (!e) {
 					e = regmap_write(r, xattr->reg_offset, BIT(i));
+					cisco_fpga_sysfs_cache_invalidate(dev);
 					if (!e)
 						e = bufp - buf;
 				}
@@ -202,6 +203,7 @@ _scratch_store_u32(struct device *dev,
 
 			if (!*bufp) {
 				e = regmap_write(r, xattr->reg_offset, i);
+				cisco_fpga_sysfs_cache_invalidate(dev);
 				if (!e)
 					e = bufp - buf;
 			}
@@ -214,6 +216,7 @@ _scratch_store_u32(struct device *dev,
 		if ((sscanf(buf, "%i %n", &value, &consumed) == 1)
 						&& (consumed == buflen)) {
 			e = regmap_write(r, xattr->reg_offset, value);
+			cisco_fpga_sysfs_cache_invalidate(dev);
 			if (!e)
 				e = consumed;
 		}
@@ -272,6 +275,7 @@ _scratch_store_hw_ver(struct device *dev,
 	if (!e) {
 		if ((major < 0x10000) && (minor < 0x10000)) {
 			e = regmap_write(r, xattr->reg_offset, (major << 16) | minor);
+			cisco_fpga_sysfs_cache_invalidate(dev);
 			if (!e)
 				e = consumed;
 		} else {
@@ -366,6 +370,7 @@ _scratch_store_str(struct device *dev,
 			nl += sizeof(v);
 			len += sizeof(v);
 		}
+		cisco_fpga_sysfs_cache_invalidate(dev);
 		err = buflen;
 	} else {
 		err = -EINVAL;
@@ -5,25 +5,405 @@
  * Copyright (c) 2019, 2022 by Cisco Systems, Inc.
  * All rights reserved.
  */
+#include <linux/module.h>
 #include <linux/compiler.h>
 #include <linux/device.h>
 #include <linux/io.h>
 #include <linux/delay.h>
+#include <linux/regmap.h>
+#include <linux/debugfs.h>
+#include <linux/slab.h>
+#include <linux/mutex.h>
+#include <linux/ktime.h>
+#include <linux/uaccess.h>
 
 #undef DEBUG_REG_TRACE
 #define DEBUG_REG_TRACE 1
 #include <cisco/reg_access.h>
+#include <cisco/mfd.h>
+#include <cisco/sysfs.h>
+#include <cisco/util.h>
 
 void
 reg_write32(const struct device *dev, uint32_t v, void __iomem *addr)
 {
 	iowrite32(v, addr);
+	reg_trace_access(dev, REG_TRACE_OP_WRITE, addr, v, 0);
 }
 EXPORT_SYMBOL(reg_write32);
 
 uint32_t
 reg_read32(const struct device *dev, void __iomem *addr)
 {
-	return ioread32(addr);
+	uint32_t v = ioread32(addr);
+
+	reg_trace_access(dev, REG_TRACE_OP_READ, addr, v, 0);
+	return v;
 }
 EXPORT_SYMBOL(reg_read32);
+
+/*
+ * Longest run of writes handed to a single regmap_multi_reg_write();
+ * bounded so the sequence can live on the stack.
+ */
+#define CISCO_REG_BATCH_SEQ_MAX 16
+
+static struct cisco_reg_batch_op *
+_batch_op(struct cisco_reg_batch *b, uint32_t op, uint32_t reg)
+{
+	struct cisco_reg_batch_op *o;
+
+	if (b->err)
+		return NULL;
+	if (b->n >= b->max) {
+		b->err = -ENOSPC;
+		return NULL;
+	}
+	o = &b->ops[b->n++];
+	o->op = op;
+	o->reg = reg;
+	o->count = 0;
+	o->mask = 0;
+	o->value = 0;
+	o->data = NULL;
+	return o;
+}
+
+int
+cisco_reg_batch_read(struct cisco_reg_batch *b, uint32_t reg,
+		     uint32_t *data, size_t count)
+{
+	struct cisco_reg_batch_op *o;
+
+	if (b->err)
+		return b->err;
+	if (!count || (count > U32_MAX)) {
+		b->err = -EINVAL;
+		return b->err;
+	}
+
+	/* Extend the previous read if this one continues it. */
+	if (b->n) {
+		o = &b->ops[b->n - 1];
+		if ((o->op == CISCO_REG_BATCH_OP_READ) &&
+		    (o->data + o->count == data) &&
+		    (o->reg + o->count * regmap_get_reg_stride(b->r) == reg) &&
+		    (count <= U32_MAX - o->count)) {
+			o->count += count;
+			return 0;
+		}
+	}
+	o = _batch_op(b, CISCO_REG_BATCH_OP_READ, reg);
+	if (!o)
+		return b->err;
+	o->count = count;
+	o->data = data;
+	return 0;
+}
+EXPORT_SYMBOL(cisco_reg_batch_read);
+
+int
+cisco_reg_batch_write(struct cisco_reg_batch *b, uint32_t reg, uint32_t value)
+{
+	struct cisco_reg_batch_op *o = _batch_op(b, CISCO_REG_BATCH_OP_WRITE, reg);
+
+	if (!o)
+		return b->err;
+	o->value = value;
+	return 0;
+}
+EXPORT_SYMBOL(cisco_reg_batch_write);
+
+int
+cisco_reg_batch_update(struct cisco_reg_batch *b, uint32_t reg,
+		       uint32_t mask, uint32_t value)
+{
+	struct cisco_reg_batch_op *o = _batch_op(b, CISCO_REG_BATCH_OP_UPDATE, reg);
+
+	if (!o)
+		return b->err;
+	o->mask = mask;
+	o->value = value;
+	return 0;
+}
+EXPORT_SYMBOL(cisco_reg_batch_update);
+
+static int
+_batch_run_writes(struct cisco_reg_batch *b, uint32_t *index)
+{
+	struct reg_sequence seq[CISCO_REG_BATCH_SEQ_MAX];
+	uint32_t i = *index;
+	int n = 0;
+
+	while ((i < b->n) && (n < ARRAY_SIZE(seq)) &&
+	       (b->ops[i].op == CISCO_REG_BATCH_OP_WRITE)) {
+		seq[n].reg = b->ops[i].reg;
+		seq[n].def = b->ops[i].value;
+		seq[n].delay_us = 0;
+		++n;
+		++i;
+	}
+	*index = i;
+	if (n == 1)
+		return regmap_write(b->r, seq[0].reg, seq[0].def);
+	return regmap_multi_reg_write(b->r, seq, n);
+}
+
+int
+cisco_reg_batch_run(struct cisco_reg_batch *b)
+{
+	struct cisco_reg_batch_op *o;
+	uint32_t i = 0;
+	int e = b->err;
+
+	if (!e && !b->r)
+		e = -ENXIO;
+
+	while (!e && (i < b->n)) {
+		o = &b->ops[i];
+		switch (o->op) {
+		case CISCO_REG_BATCH_OP_READ:
+			if (o->count == 1)
+				e = regmap_read(b->r, o->reg, o->data);
+			else
+				e = regmap_bulk_read(b->r, o->reg, o->data, o->count);
+			++i;
+			break;
+
+		case CISCO_REG_BATCH_OP_WRITE:
+			e = _batch_run_writes(b, &i);
+			break;
+
+		case CISCO_REG_BATCH_OP_UPDATE:
+			e = regmap_update_bits(b->r, o->reg, o->mask, o->value);
+			++i;
+			break;
+
+		default:
+			e = -EINVAL;
+			break;
+		}
+	}
+	return e;
+}
+EXPORT_SYMBOL(cisco_reg_batch_run);
+
+/*
+ * debugfs batch file
+ */
+struct reg_batch_dev {
+	struct device *dev;
+	struct regmap *r;
+	struct dentry *file;
+};
+
+struct reg_batch_file {
+	struct reg_batch_dev *bd;
+	struct mutex lock;
+	size_t n;
+	struct cisco_reg_batch_result *results;
+};
+
+static int
+_batch_poll(struct regmap *r, const struct cisco_reg_batch_cmd *c,
+	    uint32_t *v, bool fast_io, u64 batch_deadline)
+{
+	u64 deadline = ktime_get_ns() + (u64)c->timeout_us * NSEC_PER_USEC;
+	int e;
+
+	/* the budget is shared by all polls of the batch */
+	deadline = min(deadline, batch_deadline);
+
+	for (;;) {
+		e = cisco_regmap_read_locked(r, c->reg, v);
+		if (e || ((*v & c->mask) == c->value))
+			return e;
+		if (ktime_get_ns() >= deadline)
+			return -ETIMEDOUT;
+		if (fast_io)
+			udelay(1);
+		else
+			usleep_range(10, 20);
+	}
+}
+
+static void
+_batch_exec(struct reg_batch_dev *bd, const struct cisco_reg_batch_cmd *cmds,
+	    struct cisco_reg_batch_result *results, size_t n)
+{
+	struct regmap *r = bd->r;
+	bool fast_io = cisco_fpga_mfd_fast_io(bd->dev);
+	int stride = regmap_get_reg_stride(r);
+	int max_reg = regmap_get_max_register(r);
+	const struct cisco_reg_batch_cmd *c;
+	uint32_t max_us = fast_io ? CISCO_REG_BATCH_POLL_MAX_US_FAST_IO
+				  : CISCO_REG_BATCH_POLL_MAX_US;
+	u64 deadline;
+	uint32_t v;
+	size_t i;
+	bool wrote = false;
+	int e = 0;
+
+	cisco_regmap_lock(r);
+	deadline = ktime_get_ns() + (u64)max_us * NSEC_PER_USEC;
+	for (i = 0; i < n; ++i) {
+		c = &cmds[i];
+		v = 0;
+		if (e) {
+			results[i].value = 0;
+			results[i].e = -ECANCELED;
+			continue;
+		}
+		if ((c->reg % stride) || ((max_reg > 0) && (c->reg > max_reg))) {
+			e = -EINVAL;
+		} else {
+			switch (c->op) {
+			case CISCO_REG_BATCH_OP_READ:
+				e = cisco_regmap_read_locked(r, c->reg, &v);
+				break;
+
+			case CISCO_REG_BATCH_OP_WRITE:
+				v = c->value;
+				e = cisco_regmap_write_locked(r, c->reg, v);
+				wrote = true;
+				break;
+
+			case CISCO_REG_BATCH_OP_UPDATE:
+				e = cisco_regmap_read_locked(r, c->reg, &v);
+				if (!e) {
+					v = (v & ~c->mask) | (c->value & c->mask);
+					e = cisco_regmap_write_locked(r, c->reg, v);
+					wrote = true;
+				}
+				break;
+
+			case CISCO_REG_BATCH_OP_POLL:
+				e = _batch_poll(r, c, &v, fast_io, deadline);
+				break;
+
+			default:
+				e = -EINVAL;
+				break;
+			}
+		}
+		results[i].value = v;
+		results[i].e = e;
+	}
+	cisco_regmap_unlock(r);
+
+	if (wrote)
+		cisco_fpga_sysfs_cache_invalidate(bd->dev);
+}
+
+static int
+_batch_open(struct inode *inode, struct file *file)
+{
+	struct reg_batch_file *bf = kzalloc(sizeof(*bf), GFP_KERNEL);
+
+	if (!bf)
+		return -ENOMEM;
+	bf->bd = inode->i_private;
+	mutex_init(&bf->lock);
+	file->private_data = bf;
+	return 0;
+}
+
+static ssize_t
+_batch_write(struct file *file, const char __user *buf,
+	     size_t count, loff_t *ppos)
+{
+	struct reg_batch_file *bf = file->private_data;
+	struct cisco_reg_batch_cmd *cmds;
+	struct cisco_reg_batch_result *results;
+	size_t n = count / sizeof(*cmds);
+
+	if (!n || (count % sizeof(*cmds)) || (n > CISCO_REG_BATCH_CMD_MAX))
+		return -EINVAL;
+
+	cmds = memdup_user(buf, count);
+	if (IS_ERR(cmds))
+		return PTR_ERR(cmds);
+	results = kcalloc(n, sizeof(*results), GFP_KERNEL);
+	if (!results) {
+		kfree(cmds);
+		return -ENOMEM;
+	}
+
+	_batch_exec(bf->bd, cmds, results, n);
+	kfree(cmds);
+
+	mutex_lock(&bf->lock);
+	kfree(bf->results);
+	bf->results = results;
+	bf->n = n;
+	*ppos = 0;
+	mutex_unlock(&bf->lock);
+	return count;
+}
+
+static ssize_t
+_batch_read(struct file *file, char __user *buf,
+	    size_t count, loff_t *ppos)
+{
+	struct reg_batch_file *bf = file->private_data;
+	ssize_t e;
+
+	mutex_lock(&bf->lock);
+	e = simple_read_from_buffer(buf, count, ppos, bf->results,
+				    bf->n * sizeof(*bf->results));
+	mutex_unlock(&bf->lock);
+	return e;
+}
+
+static int
+_batch_release(struct inode *inode, struct file *file)
+{
+	struct reg_batch_file *bf = file->private_data;
+
+	mutex_destroy(&bf->lock);
+	kfree(bf->results);
+	kfree(bf);
+	return 0;
+}
+
+static const struct file_operations _batch_fops = {
+	.owner = THIS_MODULE,
+	.open = _batch_open,
+	.read = _batch_read,
+	.write = _batch_write,
+	.llseek = default_llseek,
+	.release = _batch_release,
+};
+
+static void
+_batch_dev_release(void *data)
+{
+	struct reg_batch_dev *bd = data;
+
+	/* waits for open files to finish with bd */
+	debugfs_remove(bd->file);
+	kfree(bd);
+}
+
+int
+cisco_reg_batch_debugfs_init(struct device *dev, struct regmap *r)
+{
+	struct dentry *parent = cisco_fpga_debugfs_dir(dev);
+	struct reg_batch_dev *bd;
+
+	if (IS_ERR_OR_NULL(parent))
+		return parent ? PTR_ERR(parent) : -ENODEV;
+	if (!r)
+		return -ENXIO;
+
+	bd = kzalloc(sizeof(*bd), GFP_KERNEL);
+	if (!bd)
+		return -ENOMEM;
+
+	bd->dev = dev;
+	bd->r = r;
+	bd->file = debugfs_create_file("batch", 0600, parent, bd, &_batch_fops);
+
+	return devm_add_action_or_reset(dev, _batch_dev_release, bd);
+}
+EXPORT_SYMBOL(cisco_reg_batch_debugfs_init);
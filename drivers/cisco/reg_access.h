@@ -12,7 +12,10 @@
 #include <linux/io.h>
 #include <linux/delay.h>
 
+#include "cisco/reg_trace.h"
+
 struct device;
+struct regmap;
 
 static inline uint32_t
 _reg_mask(uint32_t hi, uint32_t lo)
@@ -56,17 +59,21 @@ extern uint32_t reg_read32(const struct device *dev,
 
 #else /* !DEBUG_REG_TRACE */
 static inline void
-reg_write32(const struct device *dev __always_unused,
+reg_write32(const struct device *dev,
 	    uint32_t v, void __iomem *addr)
 {
 	iowrite32(v, addr);
+	reg_trace_access(dev, REG_TRACE_OP_WRITE, addr, v, 0);
 }
 
 static inline uint32_t
-reg_read32(const struct device *dev __always_unused,
+reg_read32(const struct device *dev,
 	   void __iomem *addr)
 {
-	return ioread32(addr);
+	uint32_t v = ioread32(addr);
+
+	reg_trace_access(dev, REG_TRACE_OP_READ, addr, v, 0);
+	return v;
 }
 #endif /* !DEBUG_REG_TRACE */
 
@@ -127,11 +134,91 @@ reg_read32(const struct device *dev __always_unused,
 #define REG_UPDATE_BITS(...)    _REG_UPDATE_BITS(__VA_ARGS__)
 #define REG_UPDATE_BITSe(...)    _REG_UPDATE_BITSe(__VA_ARGS__)
 
+/*
+ * Batched register transactions.
+ *
+ * Operations are queued against one regmap and issued together by
+ * cisco_reg_batch_run().  Reads of consecutive registers into consecutive
+ * buffer locations are merged as they are queued and issued with a single
+ * regmap_bulk_read(); back to back writes are issued with a single
+ * regmap_multi_reg_write().  Each of those takes the regmap lock once.
+ *
+ * Queueing errors are sticky; the first one is returned by
+ * cisco_reg_batch_run() without touching the hardware.
+ */
+enum cisco_reg_batch_op_t {
+	CISCO_REG_BATCH_OP_READ,
+	CISCO_REG_BATCH_OP_WRITE,
+	CISCO_REG_BATCH_OP_UPDATE,
+	CISCO_REG_BATCH_OP_POLL,	/* debugfs batch file only */
+};
+
+struct cisco_reg_batch_op {
+	uint32_t op;
+	uint32_t reg;
+	uint32_t count;		/* READ */
+	uint32_t mask;		/* UPDATE */
+	uint32_t value;		/* WRITE, UPDATE */
+	uint32_t *data;		/* READ */
+};
+
+struct cisco_reg_batch {
+	struct regmap *r;
+	uint32_t n;
+	uint32_t max;
+	int err;
+	struct cisco_reg_batch_op *ops;
+};
+
+#define CISCO_REG_BATCH(_name, _r, _max) \
+	struct cisco_reg_batch_op _name ## _ops[_max]; \
+	struct cisco_reg_batch _name = { \
+		.r = (_r), \
+		.max = (_max), \
+		.ops = _name ## _ops, \
+	}
+
+static inline void
+cisco_reg_batch_reset(struct cisco_reg_batch *b)
+{
+	b->n = 0;
+	b->err = 0;
+}
+
+extern int cisco_reg_batch_read(struct cisco_reg_batch *b, uint32_t reg,
+				uint32_t *data, size_t count);
+extern int cisco_reg_batch_write(struct cisco_reg_batch *b, uint32_t reg,
+				 uint32_t value);
+extern int cisco_reg_batch_update(struct cisco_reg_batch *b, uint32_t reg,
+				  uint32_t mask, uint32_t value);
+extern int cisco_reg_batch_run(struct cisco_reg_batch *b);
+
+#define _REG_BATCH_READ(b, block, reg, field, hi, lo, type, d) \
+	cisco_reg_batch_read(b, offsetof(struct type, reg), (d), 1)
+
+#define _REG_BATCH_UPDATE_BITS(b, block, reg, field, hi, lo, type, d) \
+	cisco_reg_batch_update(b, offsetof(struct type, reg), _reg_mask_lo((hi), (lo)), _reg_set((d), (hi), (lo)))
+
+#define _REG_BATCH_UPDATE_BITSe(b, block, reg, field, hi, lo, type, d) \
+	cisco_reg_batch_update(b, offsetof(struct type, reg), _reg_mask_lo((hi), (lo)), \
+			       _reg_set(_REG_CONST(block, reg, field, hi, lo, type, d), (hi), (lo)))
+
+#define REG_BATCH_READ(...)           _REG_BATCH_READ(__VA_ARGS__)
+#define REG_BATCH_UPDATE_BITS(...)    _REG_BATCH_UPDATE_BITS(__VA_ARGS__)
+#define REG_BATCH_UPDATE_BITSe(...)   _REG_BATCH_UPDATE_BITSe(__VA_ARGS__)
+
 struct reg_field_value_t {
 	uint32_t mask;
 	uint32_t value;
 	const char *description;
 };
+#define REG_FIELD_VALUE(_value, _description) \
+	{ \
+		.mask = U32_MAX, \
+		.value = _value, \
+		.description = _description, \
+	}
+#define REG_FIELD_VALUE_TERMINATOR { 0, 0, 0 }
 
 struct reg_field_layout_t {
 	const char *field_name;
@@ -165,4 +252,56 @@ struct reg_layout_t {
 #define REG_LAYOUT(...) _REG_LAYOUT(__VA_ARGS__)
 #define REG_LAYOUT_TERMINATOR       { 0, 0, 0, 0 }
 
+/*
+ * Register transaction file.
+ *
+ * debugfs cisco-fpga/<device>/batch takes a write of an array of
+ * struct cisco_reg_batch_cmd and runs it under the block's regmap lock,
+ * so no other access to the block interleaves with it.  A following
+ * read returns one struct cisco_reg_batch_result per command:
+ *
+ *   READ   value = register
+ *   WRITE  register = value
+ *   UPDATE register = (register & ~mask) | (value & mask); value = result
+ *   POLL   read until (register & mask) == value, for up to timeout_us;
+ *          value = last read, e = -ETIMEDOUT if it never matched
+ *
+ * All POLL commands of a batch together wait no longer than
+ * CISCO_REG_BATCH_POLL_MAX_US (CISCO_REG_BATCH_POLL_MAX_US_FAST_IO with
+ * interrupts off under a fast_io regmap lock).
+ *
+ * Execution stops at the first error; later commands report -ECANCELED.
+ * The commands access the hardware directly; registers written are
+ * dropped from the regmap cache afterwards.
+ */
+struct cisco_reg_batch_cmd {
+	uint32_t op;		/* enum cisco_reg_batch_op_t */
+	uint32_t reg;
+	uint32_t mask;		/* UPDATE, POLL */
+	uint32_t value;		/* WRITE, UPDATE, POLL */
+	uint32_t timeout_us;	/* POLL */
+};
+
+struct cisco_reg_batch_result {
+	uint32_t value;
+	int32_t e;
+};
+
+#define CISCO_REG_BATCH_CMD_MAX		512
+#define CISCO_REG_BATCH_POLL_MAX_US	100000	/* per batch */
+#define CISCO_REG_BATCH_POLL_MAX_US_FAST_IO	1000
+
+extern int cisco_reg_batch_debugfs_init(struct device *dev, struct regmap *r);
+
+/*
+ * Decoded register dump.
+ *
+ * Creates debugfs cisco-fpga/<device>/decode, which reads the registers
+ * of the block header and of the layout table in one batch and prints
+ * every field, with the name of its value when the field has a value
+ * table.  Only list registers that are safe to read at any time.
+ */
+extern int cisco_reg_layout_debugfs_init(struct device *dev, struct regmap *r,
+					 const struct reg_layout_t *layout);
+
 #endif /* ndef _CISCO_REG_ACCESS_H */
@@ -0,0 +1,306 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Register layout decode
+ *
+ * Copyright (c) 2022 by Cisco Systems, Inc.
+ * All rights reserved.
+ */
+#include <linux/module.h>
+#include <linux/device.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/regmap.h>
+
+#include "cisco/reg_access.h"
+#include "cisco/hdr.h"
+#include "cisco/lrstr.h"
+#include "cisco/mdio.h"
+#include "cisco/util.h"
+
+struct reg_layout_dev {
+	struct regmap *r;
+	const struct reg_layout_t *layouts[2];	/* header, block */
+	struct dentry *file;
+};
+
+static size_t
+_layout_count(const struct reg_layout_t *l)
+{
+	size_t n = 0;
+
+	for (; l && l->block; ++l)
+		++n;
+	return n;
+}
+
+static void
+_decode_field(struct seq_file *m, const struct reg_field_layout_t *f, u32 v)
+{
+	const struct reg_field_value_t *fv;
+	u32 d = _reg_get(v, f->hi, f->lo);
+
+	if (f->hi == f->lo)
+		seq_printf(m, "    %-24s [%u]    %#x", f->field_name, f->lo, d);
+	else
+		seq_printf(m, "    %-24s [%u:%u] %#x", f->field_name, f->hi, f->lo, d);
+	for (fv = f->values; fv && fv->description; ++fv) {
+		if ((d & fv->mask) == fv->value) {
+			seq_printf(m, " (%s)", fv->description);
+			break;
+		}
+	}
+	seq_putc(m, '\n');
+}
+
+/*
+ * All registers are queued on one batch, so each run of consecutive
+ * registers is a single bulk read.
+ */
+static int
+_decode_show(struct seq_file *m, void *p)
+{
+	struct reg_layout_dev *ld = m->private;
+	const struct reg_layout_t *l;
+	const struct reg_field_layout_t *f;
+	struct cisco_reg_batch b = { .r = ld->r };
+	u32 *data;
+	size_t i, n = 0;
+	int e = -ENOMEM;
+
+	for (i = 0; i < ARRAY_SIZE(ld->layouts); ++i)
+		n += _layout_count(ld->layouts[i]);
+	if (!n)
+		return 0;
+
+	data = kcalloc(n, sizeof(*data), GFP_KERNEL);
+	b.ops = kcalloc(n, sizeof(*b.ops), GFP_KERNEL);
+	b.max = n;
+	if (!data || !b.ops)
+		goto done;
+
+	for (n = 0, i = 0; i < ARRAY_SIZE(ld->layouts); ++i)
+		for (l = ld->layouts[i]; l && l->block; ++l)
+			cisco_reg_batch_read(&b, l->offset, &data[n++], 1);
+	e = cisco_reg_batch_run(&b);
+	if (e)
+		goto done;
+
+	for (n = 0, i = 0; i < ARRAY_SIZE(ld->layouts); ++i) {
+		for (l = ld->layouts[i]; l && l->block; ++l, ++n) {
+			seq_printf(m, "%s.%s %#06zx %#010x\n",
+				   l->block, l->reg_name, l->offset, data[n]);
+			for (f = l->fields; f && f->field_name; ++f)
+				_decode_field(m, f, data[n]);
+		}
+	}
+
+done:
+	kfree(b.ops);
+	kfree(data);
+	return e;
+}
+DEFINE_SHOW_ATTRIBUTE(_decode);
+
+static void
+_layout_release(void *data)
+{
+	struct reg_layout_dev *ld = data;
+
+	/* waits for open files to finish with ld */
+	debugfs_remove(ld->file);
+	kfree(ld);
+}
+
+int
+cisco_reg_layout_debugfs_init(struct device *dev, struct regmap *r,
+			      const struct reg_layout_t *layout)
+{
+	struct dentry *parent = cisco_fpga_debugfs_dir(dev);
+	struct reg_layout_dev *ld;
+
+	if (IS_ERR_OR_NULL(parent))
+		return parent ? PTR_ERR(parent) : -ENODEV;
+	if (!r)
+		return -ENXIO;
+
+	ld = kzalloc(sizeof(*ld), GFP_KERNEL);
+	if (!ld)
+		return -ENOMEM;
+
+	ld->r = r;
+	ld->layouts[0] = regblk_hdr_t_layout;
+	ld->layouts[1] = layout;
+	ld->file = debugfs_create_file("decode", 0400, parent, ld, &_decode_fops);
+
+	return devm_add_action_or_reset(dev, _layout_release, ld);
+}
+EXPORT_SYMBOL(cisco_reg_layout_debugfs_init);
+
+/*
+ * Layouts of blocks whose drivers are built elsewhere.
+ */
+
+/* mdio */
+static const struct reg_field_value_t mdio_cfg_ctrlMode_values[] = {
+	REG_FIELD_VALUE(mdio_cfg_ctrlMode__CLAUSE_22, "clause 22"),
+	REG_FIELD_VALUE(mdio_cfg_ctrlMode__CLAUSE_45, "clause 45"),
+	REG_FIELD_VALUE_TERMINATOR
+};
+
+static const struct reg_field_value_t mdio_cfg_accessType_values[] = {
+	REG_FIELD_VALUE(mdio_cfg_accessType__WRITE_OP, "write"),
+	REG_FIELD_VALUE(mdio_cfg_accessType__READ_OP, "read"),
+	REG_FIELD_VALUE_TERMINATOR
+};
+
+static const struct reg_field_layout_t mdio_regs_v4_t_intrCfg0_field_layout[] = {
+	REG_FIELD_LAYOUT(MDIO_INTRCFG0_DATA, 0),
+	REG_FIELD_LAYOUT_TERMINATOR
+};
+
+static const struct reg_field_layout_t mdio_regs_v4_t_intrCfg1_field_layout[] = {
+	REG_FIELD_LAYOUT(MDIO_INTRCFG1_MSI, 0),
+	REG_FIELD_LAYOUT_TERMINATOR
+};
+
+static const struct reg_field_layout_t mdio_regs_v4_t_cfg_field_layout[] = {
+	REG_FIELD_LAYOUT(MDIO_CFG_START, 0),
+	REG_FIELD_LAYOUT(MDIO_CFG_PREAMBLEDIS, 0),
+	REG_FIELD_LAYOUT(MDIO_CFG_CTRLMODE, mdio_cfg_ctrlMode_values),
+	REG_FIELD_LAYOUT(MDIO_CFG_MDIOCLKFREQ, 0),
+	REG_FIELD_LAYOUT(MDIO_CFG_DEVREGADDR, 0),
+	REG_FIELD_LAYOUT(MDIO_CFG_ACCESSTYPE, mdio_cfg_accessType_values),
+	REG_FIELD_LAYOUT(MDIO_CFG_ACCESSWIDTH, 0),
+	REG_FIELD_LAYOUT(MDIO_CFG_MTKMODE, 0),
+	REG_FIELD_LAYOUT(MDIO_CFG_PHYADDR, 0),
+	REG_FIELD_LAYOUT(MDIO_CFG_DEVSEL, 0),
+	REG_FIELD_LAYOUT_TERMINATOR
+};
+
+static const struct reg_field_layout_t mdio_regs_v4_t_addr_field_layout[] = {
+	REG_FIELD_LAYOUT(MDIO_ADDR, 0),
+	REG_FIELD_LAYOUT_TERMINATOR
+};
+
+static const struct reg_field_layout_t mdio_regs_v4_t_wdata_field_layout[] = {
+	REG_FIELD_LAYOUT(MDIO_WDATA, 0),
+	REG_FIELD_LAYOUT_TERMINATOR
+};
+
+static const struct reg_field_layout_t mdio_regs_v4_t_rdata_field_layout[] = {
+	REG_FIELD_LAYOUT(MDIO_RDATA, 0),
+	REG_FIELD_LAYOUT_TERMINATOR
+};
+
+static const struct reg_field_layout_t mdio_regs_v4_t_trist_field_layout[] = {
+	REG_FIELD_LAYOUT(MDIO_TRIST_FORCELOW, 0),
+	REG_FIELD_LAYOUT(MDIO_TRIST_CLKFREQ, 0),
+	REG_FIELD_LAYOUT(MDIO_TRIST_TRISTATE, 0),
+	REG_FIELD_LAYOUT_TERMINATOR
+};
+
+static const struct reg_field_layout_t mdio_regs_v4_t_doneIntSts_field_layout[] = {
+	REG_FIELD_LAYOUT(MDIO_DONEINTSTS_DONEINT, 0),
+	REG_FIELD_LAYOUT_TERMINATOR
+};
+
+static const struct reg_field_layout_t mdio_regs_v4_t_doneIntEnb_field_layout[] = {
+	REG_FIELD_LAYOUT(MDIO_DONEINTENB_DONEIE, 0),
+	REG_FIELD_LAYOUT_TERMINATOR
+};
+
+static const struct reg_layout_t _mdio_regs_v4_t_layout[] = {
+	REG_LAYOUT(MDIO_INTRCFG0),
+	REG_LAYOUT(MDIO_INTRCFG1),
+	REG_LAYOUT(MDIO_CFG),
+	REG_LAYOUT(MDIO_ADDR),
+	REG_LAYOUT(MDIO_WDATA),
+	REG_LAYOUT(MDIO_RDATA),
+	REG_LAYOUT(MDIO_TRIST),
+	REG_LAYOUT(MDIO_DONEINTSTS),
+	REG_LAYOUT(MDIO_DONEINTENB),
+	REG_LAYOUT_TERMINATOR
+};
+
+const struct reg_layout_t *mdio_regs_v4_t_layout = _mdio_regs_v4_t_layout;
+EXPORT_SYMBOL(mdio_regs_v4_t_layout);
+
+/* lrstr; fifo_out is left out because reading it pops the fifo */
+static const struct reg_field_layout_t lrstr_regs_v4_t_intrCfg0_field_layout[] = {
+	REG_FIELD_LAYOUT(LRSTR_INTRCFG0_DATA, 0),
+	REG_FIELD_LAYOUT_TERMINATOR
+};
+
+static const struct reg_field_layout_t lrstr_regs_v4_t_intrCfg1_field_layout[] = {
+	REG_FIELD_LAYOUT(LRSTR_INTRCFG1_MSI, 0),
+	REG_FIELD_LAYOUT_TERMINATOR
+};
+
+static const struct reg_field_layout_t lrstr_regs_v4_t_timer_field_layout[] = {
+	REG_FIELD_LAYOUT(LRSTR_TIMER_HOURS, 0),
+	REG_FIELD_LAYOUT(LRSTR_TIMER_MINUTES, 0),
+	REG_FIELD_LAYOUT(LRSTR_TIMER_SECONDS, 0),
+	REG_FIELD_LAYOUT(LRSTR_TIMER_MILLISECONDS, 0),
+	REG_FIELD_LAYOUT_TERMINATOR
+};
+
+static const struct reg_field_layout_t lrstr_regs_v4_t_update_timer_field_layout[] = {
+	REG_FIELD_LAYOUT(LRSTR_UPDATE_TIMER_HOURS, 0),
+	REG_FIELD_LAYOUT(LRSTR_UPDATE_TIMER_MINUTES, 0),
+	REG_FIELD_LAYOUT(LRSTR_UPDATE_TIMER_SECONDS, 0),
+	REG_FIELD_LAYOUT(LRSTR_UPDATE_TIMER_MILLISECONDS, 0),
+	REG_FIELD_LAYOUT_TERMINATOR
+};
+
+static const struct reg_field_layout_t lrstr_regs_v4_t_days_field_layout[] = {
+	REG_FIELD_LAYOUT(LRSTR_DAYS_DAYS, 0),
+	REG_FIELD_LAYOUT_TERMINATOR
+};
+
+static const struct reg_field_layout_t lrstr_regs_v4_t_update_days_field_layout[] = {
+	REG_FIELD_LAYOUT(LRSTR_UPDATE_DAYS_DAYS, 0),
+	REG_FIELD_LAYOUT_TERMINATOR
+};
+
+static const struct reg_field_layout_t lrstr_regs_v4_t_fifo_status_field_layout[] = {
+	REG_FIELD_LAYOUT(LRSTR_FIFO_STATUS_THRESHOLD, 0),
+	REG_FIELD_LAYOUT(LRSTR_FIFO_STATUS_FULLNESS, 0),
+	REG_FIELD_LAYOUT(LRSTR_FIFO_STATUS_FULL, 0),
+	REG_FIELD_LAYOUT(LRSTR_FIFO_STATUS_EMPTY, 0),
+	REG_FIELD_LAYOUT_TERMINATOR
+};
+
+static const struct reg_field_layout_t lrstr_regs_v4_t_intSts_field_layout[] = {
+	REG_FIELD_LAYOUT(LRSTR_INTSTS_FIFO_WATERMARK, 0),
+	REG_FIELD_LAYOUT(LRSTR_INTSTS_EON_ROLLOVER, 0),
+	REG_FIELD_LAYOUT(LRSTR_INTSTS_DAY_WRITE, 0),
+	REG_FIELD_LAYOUT(LRSTR_INTSTS_TIMER_ROLLOVER, 0),
+	REG_FIELD_LAYOUT(LRSTR_INTSTS_TIMER_WRITE, 0),
+	REG_FIELD_LAYOUT_TERMINATOR
+};
+
+static const struct reg_field_layout_t lrstr_regs_v4_t_intEnb_field_layout[] = {
+	REG_FIELD_LAYOUT(LRSTR_INTENB_FIFO_WATERMARK, 0),
+	REG_FIELD_LAYOUT(LRSTR_INTENB_EON_ROLLOVER, 0),
+	REG_FIELD_LAYOUT(LRSTR_INTENB_DAY_WRITE, 0),
+	REG_FIELD_LAYOUT(LRSTR_INTENB_TIMER_ROLLOVER, 0),
+	REG_FIELD_LAYOUT(LRSTR_INTENB_TIMER_WRITE, 0),
+	REG_FIELD_LAYOUT_TERMINATOR
+};
+
+static const struct reg_layout_t _lrstr_regs_v4_t_layout[] = {
+	REG_LAYOUT(LRSTR_INTRCFG0),
+	REG_LAYOUT(LRSTR_INTRCFG1),
+	REG_LAYOUT(LRSTR_TIMER),
+	REG_LAYOUT(LRSTR_UPDATE_TIMER),
+	REG_LAYOUT(LRSTR_DAYS),
+	REG_LAYOUT(LRSTR_UPDATE_DAYS),
+	REG_LAYOUT(LRSTR_FIFO_STATUS),
+	REG_LAYOUT(LRSTR_INTSTS),
+	REG_LAYOUT(LRSTR_INTENB),
+	REG_LAYOUT_TERMINATOR
+};
+
+const struct reg_layout_t *lrstr_regs_v4_t_layout = _lrstr_regs_v4_t_layout;
+EXPORT_SYMBOL(lrstr_regs_v4_t_layout);
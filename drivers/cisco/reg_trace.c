@@ -10,44 +10,55 @@
 #include <linux/device.h>
 #include <linux/io.h>
 #include <linux/delay.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/rculist.h>
+#include <linux/spinlock.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/cpu.h>
+#include <linux/smp.h>
+#include <linux/log2.h>
+#include <linux/math64.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/uio.h>
+#include <linux/fs.h>
 #include <cisco/reg_trace.h>
+#include <cisco/util.h>
 #include <linux/slab.h>
 
+#define REG_TRACE_DEFAULT_SIZE (64 * 1024)
+
 void
 reg_trace_display_buffer(struct device *dev,
 			 const char *title,
 			 const uint8_t *datap, size_t count)
 {
-#define _c(b) ((((b) >= 0x20) && ((b) <= 0x7e)) ? b : '.')
-	size_t offset = 0;
+	size_t offset;
 	char buffer[128];
 
-	while (count) {
-		snprintf(buffer, sizeof(buffer),
-			 "%02x %02x %02x %02x %02x %02x %02x %02x %02x %02x %02x %02x %02x %02x %02x %02x %c%c%c%c%c%c%c%c%c%c%c%c%c%c%c%c",
-			 datap[0], datap[1], datap[2], datap[3],
-			 datap[4], datap[5], datap[6], datap[7],
-			 datap[8], datap[9], datap[10], datap[11],
-			 datap[12], datap[13], datap[14], datap[15],
-			 _c(datap[0]), _c(datap[1]), _c(datap[2]), _c(datap[3]),
-			 _c(datap[4]), _c(datap[5]), _c(datap[6]), _c(datap[7]),
-			 _c(datap[8]), _c(datap[9]), _c(datap[10]), _c(datap[11]),
-			 _c(datap[12]), _c(datap[13]), _c(datap[14]), _c(datap[15]));
-		if (count > 15) {
-			dev_err(dev, "%s-%02zx: %s\n", title, offset, buffer);
-			count -= 16;
-			offset += 16;
-			datap += 16;
-		} else {
-			memset(buffer + count * 3, ' ', 3 * (16 - count));
-			memset(buffer + (16 * 3) + count, ' ', 16 - count);
-			dev_err(dev, "%s-%02zx: %s\n", title, offset, buffer);
-			break;
-		}
+	for (offset = 0; offset < count; offset += 16) {
+		hex_dump_to_buffer(datap + offset, min_t(size_t, count - offset, 16),
+				   16, 1, buffer, sizeof(buffer), true);
+		dev_dbg(dev, "%s-%02zx: %s\n", title, offset, buffer);
 	}
 }
 EXPORT_SYMBOL(reg_trace_display_buffer);
 
+static size_t
+_peek(const struct reg_trace_t *tracep, uint8_t *dst, size_t len)
+{
+	size_t space = _reg_trace_read_space_nowrap(tracep);
+
+	len = min(len, _reg_trace_read_space(tracep));
+	space = min(space, len);
+	memcpy(dst, &tracep->base[tracep->read_head], space);
+	if (space < len)
+		memcpy(dst + space, tracep->base, len - space);
+	return len;
+}
+
 static int
 _extract(struct reg_trace_t *tracep, void *dst, size_t len)
 {
@@ -66,27 +77,782 @@ _extract(struct reg_trace_t *tracep, void *dst, size_t len)
 	return 0;
 }
 
+/* Decode and consume a record header, advancing the walk time. */
+static bool
+_hdr_get(struct reg_trace_t *tracep, struct reg_trace_hdr_t *hdrp)
+{
+	uint8_t raw[REG_TRACE_HDR_MAX];
+	uint64_t delta, len;
+	size_t n, k;
+
+	n = _peek(tracep, raw, sizeof(raw));
+	if (!n)
+		return false;
+	k = reg_trace_varint_get(&raw[1], n - 1, &delta);
+	if (!k)
+		return false;
+	k += 1;
+	n = reg_trace_varint_get(&raw[k], n - k, &len);
+	if (!n || (len > U16_MAX))
+		return false;
+	_reg_trace_read_skip(tracep, k + n);
+
+	tracep->walk_ns += delta;
+	hdrp->ts = ns_to_timespec64(tracep->walk_ns);
+	hdrp->op = raw[0];
+	hdrp->len = len;
+	return hdrp->len <= _reg_trace_read_space(tracep);
+}
+
+/*
+ * Make room in an overwriting trace; the walk time keeps track of the
+ * dropped records so the survivors still decode to the right times.
+ */
+bool
+reg_trace_drop_oldest(struct reg_trace_t *tracep)
+{
+	struct reg_trace_hdr_t hdr;
+
+	if (_reg_trace_is_empty(tracep))
+		return false;
+	if (!_hdr_get(tracep, &hdr)) {
+		/* cannot happen; start over rather than loop */
+		tracep->read_head = tracep->write_tail;
+		return true;
+	}
+	_reg_trace_read_skip(tracep, hdr.len);
+	return true;
+}
+EXPORT_SYMBOL(reg_trace_drop_oldest);
+
+/*
+ * Records are handed to fn in place.  Only a record that wraps around the
+ * end of the ring is copied, and at most one record can do that.
+ */
 void
 reg_trace_walk(struct reg_trace_t *tracep,
 	       reg_trace_walk_fn_t fn,
 	       void *cookie)
 {
-	uint8_t *bufp = kzalloc(tracep->size, GFP_KERNEL);
 	struct reg_trace_hdr_t hdr;
+	const uint8_t *datap;
+	uint8_t *bufp;
 
-	if (!bufp) {
-		pr_err("%s: kzalloc(%#zx) failed\n", __func__, tracep->size);
-		return;
-	}
 	for (; !_reg_trace_is_empty(tracep); ) {
-		if (_extract(tracep, &hdr, sizeof(hdr)))
-			break;
-		if (hdr.len > tracep->size)
+		if (!_hdr_get(tracep, &hdr))
 			break;
-		if (_extract(tracep, bufp, hdr.len))
+		if (hdr.len <= _reg_trace_read_space_nowrap(tracep)) {
+			datap = &tracep->base[tracep->read_head];
+			_reg_trace_read_skip(tracep, hdr.len);
+			fn(tracep, cookie, &hdr, datap);
+			continue;
+		}
+		bufp = kmalloc(hdr.len, GFP_KERNEL);
+		if (!bufp) {
+			pr_err("%s: kmalloc(%#x) failed\n", __func__, hdr.len);
 			break;
+		}
+		_extract(tracep, bufp, hdr.len);
 		fn(tracep, cookie, &hdr, bufp);
+		kfree(bufp);
 	}
-	kfree(bufp);
 }
 EXPORT_SYMBOL(reg_trace_walk);
+
+DEFINE_STATIC_KEY_FALSE(reg_trace_key);
+EXPORT_SYMBOL(reg_trace_key);
+
+/*
+ * Triggers and filters, as offsets from the block's csr base.
+ *
+ * A start trigger is a write of start_value (under start_mask) to
+ * start_offset; until it happens each CPU keeps only its newest pre
+ * records.  A stop trigger is a read from stop_offset with any of
+ * stop_mask set; it keeps post more records, counting the triggering
+ * access.  With no stop trigger, a non-zero post counts from the start
+ * trigger, or from enable if there is none.  Offsets of U32_MAX disable
+ * a trigger.  Only accesses to [filter_lo, filter_hi] whose op bit is
+ * set in filter_ops are recorded; triggers see every access.
+ *
+ * The debugfs copy is latched when tracing is enabled or reset.
+ */
+struct reg_trace_trigger {
+	u32 filter_lo;
+	u32 filter_hi;
+	u32 filter_ops;
+	u32 start_offset;
+	u32 start_value;
+	u32 start_mask;
+	u32 stop_offset;
+	u32 stop_mask;
+	u32 pre;
+	u32 post;
+};
+
+#define REG_TRACE_NO_TRIGGER U32_MAX
+
+enum reg_trace_state_t {
+	REG_TRACE_STATE_ARMED,
+	REG_TRACE_STATE_RUNNING,
+	REG_TRACE_STATE_STOPPING,
+	REG_TRACE_STATE_STOPPED,
+};
+
+static const char * const _reg_trace_state_names[] = {
+	[REG_TRACE_STATE_ARMED] = "armed",
+	[REG_TRACE_STATE_RUNNING] = "running",
+	[REG_TRACE_STATE_STOPPING] = "stopping",
+	[REG_TRACE_STATE_STOPPED] = "stopped",
+};
+
+/*
+ * Per-block trace state.  Blocks with tracing enabled are on
+ * _reg_trace_active, which the access hook walks under RCU.
+ */
+struct reg_trace_dev {
+	struct list_head		node;
+	const struct device		*dev;
+	uintptr_t			base;
+	struct dentry			*dir;
+	struct mutex			ctl;	/* enable, size, rings */
+	struct reg_trace_ring_t __percpu *rings;
+	u32				gen;	/* bumped when rings change */
+	u32				size;	/* bytes per CPU */
+	bool				enabled;
+	struct reg_trace_trigger	cfg;	/* debugfs */
+	struct reg_trace_trigger	act;	/* latched */
+	int				state;
+	atomic_t			post_left;
+};
+
+static LIST_HEAD(_reg_trace_active);
+static DEFINE_SPINLOCK(_reg_trace_active_lock);
+
+/* Run the triggers; returns true if the access is to be recorded. */
+static bool
+_reg_trace_filter(struct reg_trace_dev *t, uint16_t op, u32 off, uint32_t value)
+{
+	const struct reg_trace_trigger *c = &t->act;
+	int state = READ_ONCE(t->state);
+	int n;
+
+	if (state == REG_TRACE_STATE_STOPPED)
+		return false;
+
+	if ((state == REG_TRACE_STATE_ARMED) && (op == REG_TRACE_OP_WRITE)
+	    && (off == c->start_offset)
+	    && ((value & c->start_mask) == c->start_value)) {
+		cmpxchg(&t->state, REG_TRACE_STATE_ARMED, REG_TRACE_STATE_RUNNING);
+		if (c->post && (c->stop_offset == REG_TRACE_NO_TRIGGER))
+			cmpxchg(&t->state, REG_TRACE_STATE_RUNNING,
+				REG_TRACE_STATE_STOPPING);
+		state = READ_ONCE(t->state);
+	} else if ((state == REG_TRACE_STATE_RUNNING) && (op == REG_TRACE_OP_READ)
+		   && (off == c->stop_offset) && (value & c->stop_mask)) {
+		cmpxchg(&t->state, REG_TRACE_STATE_RUNNING,
+			REG_TRACE_STATE_STOPPING);
+		state = READ_ONCE(t->state);
+	}
+
+	if ((off < c->filter_lo) || (off > c->filter_hi)
+	    || !(c->filter_ops & BIT(op)))
+		return false;
+
+	if (state == REG_TRACE_STATE_STOPPING) {
+		n = atomic_dec_return(&t->post_left);
+		if (n <= 0)
+			WRITE_ONCE(t->state, REG_TRACE_STATE_STOPPED);
+		return n >= 0;
+	}
+	return state != REG_TRACE_STATE_STOPPED;
+}
+
+void
+__reg_trace_access(const struct device *dev, uint16_t op,
+		   const void __iomem *addr, uint32_t value, int e)
+{
+	struct reg_trace_dev *t;
+	struct reg_trace_ring_t *ring;
+	unsigned long flags;
+	u32 off;
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(t, &_reg_trace_active, node) {
+		if (t->dev != dev)
+			continue;
+		off = (uintptr_t)addr - t->base;
+		if (!_reg_trace_filter(t, op, off, value))
+			break;
+		local_irq_save(flags);
+		ring = this_cpu_ptr(t->rings);
+		if (ring->armed && (READ_ONCE(t->state) != REG_TRACE_STATE_ARMED))
+			reg_trace_ring_keep(ring, t->act.pre);
+		reg_trace_ring_put(ring, op, off, value, e);
+		local_irq_restore(flags);
+		break;
+	}
+	rcu_read_unlock();
+}
+EXPORT_SYMBOL(__reg_trace_access);
+
+static void
+_reg_trace_rings_free(struct reg_trace_dev *t)
+{
+	int cpu;
+
+	if (!t->rings)
+		return;
+	for_each_possible_cpu(cpu)
+		vfree(per_cpu_ptr(t->rings, cpu)->buf);
+	free_percpu(t->rings);
+	t->rings = NULL;
+}
+
+static int
+_reg_trace_rings_alloc(struct reg_trace_dev *t)
+{
+	size_t size;
+	int cpu;
+
+	if (t->size < (2 * (REG_TRACE_TIME_MAX + REG_TRACE_REC_MAX)))
+		return -EINVAL;
+	size = rounddown_pow_of_two(t->size);
+
+	t->rings = alloc_percpu(struct reg_trace_ring_t);
+	if (!t->rings)
+		return -ENOMEM;
+	for_each_possible_cpu(cpu) {
+		struct reg_trace_ring_t *ring = per_cpu_ptr(t->rings, cpu);
+
+		/* zeroed, page aligned and mappable to user space */
+		ring->buf = vmalloc_user(size);
+		if (!ring->buf) {
+			_reg_trace_rings_free(t);
+			return -ENOMEM;
+		}
+		ring->mask = size - 1;
+		ring->armed = t->state == REG_TRACE_STATE_ARMED;
+	}
+	return 0;
+}
+
+/* Latch the debugfs trigger settings and arm them. */
+static void
+_reg_trace_arm(struct reg_trace_dev *t)
+{
+	struct reg_trace_trigger *c = &t->act;
+	int state = REG_TRACE_STATE_RUNNING;
+
+	*c = t->cfg;
+	if (c->start_offset != REG_TRACE_NO_TRIGGER)
+		state = REG_TRACE_STATE_ARMED;
+	else if (c->post && (c->stop_offset == REG_TRACE_NO_TRIGGER))
+		state = REG_TRACE_STATE_STOPPING;
+	atomic_set(&t->post_left, c->post);
+	WRITE_ONCE(t->state, state);
+}
+
+typedef void (*reg_trace_ring_fn_t)(struct reg_trace_dev *t,
+				    struct reg_trace_ring_t *ring);
+
+struct _rings_call {
+	struct reg_trace_dev *t;
+	reg_trace_ring_fn_t fn;
+};
+
+static void
+_reg_trace_ring_call(void *data)
+{
+	struct _rings_call *call = data;
+
+	call->fn(call->t, this_cpu_ptr(call->t->rings));
+}
+
+/*
+ * Run a ring operation on each CPU with interrupts disabled, so it is
+ * ordered with writers; offline CPUs cannot be writing.
+ */
+static void
+_reg_trace_rings_call(struct reg_trace_dev *t, reg_trace_ring_fn_t fn)
+{
+	struct _rings_call call = { .t = t, .fn = fn };
+	int cpu;
+
+	cpus_read_lock();
+	on_each_cpu(_reg_trace_ring_call, &call, 1);
+	for_each_possible_cpu(cpu) {
+		if (!cpu_online(cpu))
+			fn(t, per_cpu_ptr(t->rings, cpu));
+	}
+	cpus_read_unlock();
+}
+
+static void
+_reg_trace_ring_reset(struct reg_trace_dev *t, struct reg_trace_ring_t *ring)
+{
+	WRITE_ONCE(ring->tail, ring->head);
+	ring->count = 0;
+	ring->dropped = 0;
+	ring->armed = READ_ONCE(t->state) == REG_TRACE_STATE_ARMED;
+}
+
+static void
+_reg_trace_rings_reset(struct reg_trace_dev *t)
+{
+	++t->gen;
+	_reg_trace_arm(t);
+	_reg_trace_rings_call(t, _reg_trace_ring_reset);
+}
+
+/* Apply a fired start trigger to rings that have not seen an access since. */
+static void
+_reg_trace_ring_sync(struct reg_trace_dev *t, struct reg_trace_ring_t *ring)
+{
+	if (ring->armed)
+		reg_trace_ring_keep(ring, t->act.pre);
+}
+
+/*
+ * Returns false while the start trigger is armed; the rings are still
+ * overwriting then and cannot be read.
+ */
+static bool
+_reg_trace_rings_sync(struct reg_trace_dev *t)
+{
+	if (READ_ONCE(t->state) == REG_TRACE_STATE_ARMED)
+		return false;
+	_reg_trace_rings_call(t, _reg_trace_ring_sync);
+	return true;
+}
+
+static int
+_reg_trace_enable(struct reg_trace_dev *t, bool enable)
+{
+	int e = 0;
+
+	mutex_lock(&t->ctl);
+	if (enable && !t->enabled) {
+		_reg_trace_rings_free(t);
+		++t->gen;
+		_reg_trace_arm(t);
+		e = _reg_trace_rings_alloc(t);
+		if (!e) {
+			spin_lock(&_reg_trace_active_lock);
+			list_add_rcu(&t->node, &_reg_trace_active);
+			spin_unlock(&_reg_trace_active_lock);
+			t->enabled = true;
+			static_branch_inc(&reg_trace_key);
+		}
+	} else if (!enable && t->enabled) {
+		static_branch_dec(&reg_trace_key);
+		spin_lock(&_reg_trace_active_lock);
+		list_del_rcu(&t->node);
+		spin_unlock(&_reg_trace_active_lock);
+		synchronize_rcu();
+		t->enabled = false;
+		/* keep the records; they can still be read */
+	}
+	mutex_unlock(&t->ctl);
+	return e;
+}
+
+static int
+_enable_get(void *data, u64 *val)
+{
+	struct reg_trace_dev *t = data;
+
+	*val = t->enabled;
+	return 0;
+}
+
+static int
+_enable_set(void *data, u64 val)
+{
+	return _reg_trace_enable(data, !!val);
+}
+DEFINE_DEBUGFS_ATTRIBUTE(_enable_fops, _enable_get, _enable_set, "%llu\n");
+
+struct _records_iter {
+	const struct reg_trace_ring_t *ring;
+	uint32_t idx;
+	uint32_t end;
+	uint64_t ns;
+	struct reg_trace_access_t a;
+};
+
+/* Decode the next access into iter->a, and its time into iter->ns. */
+static bool
+_records_iter_next(struct _records_iter *iter)
+{
+	uint8_t buf[REG_TRACE_REC_MAX];
+	size_t len;
+
+	while (iter->idx != iter->end) {
+		len = reg_trace_ring_peek(iter->ring, iter->idx, iter->end, buf);
+		len = reg_trace_decode(buf, len, &iter->a);
+		if (!len)
+			return false;
+		iter->idx += len;
+		if (iter->a.op != REG_TRACE_OP_TIME) {
+			iter->ns += iter->a.delta;
+			return true;
+		}
+		iter->ns = iter->a.delta;
+	}
+	return false;
+}
+
+/*
+ * Merge the per-CPU rings in time order.  ctl is held, so the rings
+ * cannot be reset or freed, and records below each head are stable.
+ */
+static int
+_records_show(struct seq_file *m, void *v)
+{
+	struct reg_trace_dev *t = m->private;
+	struct _records_iter *iter, *min;
+	const struct reg_trace_access_t *a;
+	unsigned int cpu;
+	u64 sec;
+	u32 nsec;
+
+	mutex_lock(&t->ctl);
+	if (!t->rings)
+		goto unlock;
+	if (!_reg_trace_rings_sync(t)) {
+		seq_puts(m, "# waiting for start trigger\n");
+		goto unlock;
+	}
+
+	iter = kcalloc(nr_cpu_ids, sizeof(*iter), GFP_KERNEL);
+	if (!iter) {
+		mutex_unlock(&t->ctl);
+		return -ENOMEM;
+	}
+
+	for_each_possible_cpu(cpu) {
+		const struct reg_trace_ring_t *ring = per_cpu_ptr(t->rings, cpu);
+
+		iter[cpu].ring = ring;
+		iter[cpu].end = smp_load_acquire(&ring->head);
+		iter[cpu].idx = READ_ONCE(ring->tail);
+		if (!_records_iter_next(&iter[cpu]))
+			iter[cpu].ring = NULL;
+		if (READ_ONCE(ring->dropped))
+			seq_printf(m, "# cpu %u dropped %llu\n", cpu,
+				   READ_ONCE(ring->dropped));
+	}
+
+	for (;;) {
+		min = NULL;
+		for_each_possible_cpu(cpu) {
+			if (iter[cpu].ring && (!min || (iter[cpu].ns < min->ns)))
+				min = &iter[cpu];
+		}
+		if (!min)
+			break;
+
+		a = &min->a;
+		sec = div_u64_rem(min->ns, NSEC_PER_SEC, &nsec);
+		seq_printf(m, "%llu.%09u %u %c %#06x %#010x %d\n",
+			   sec, nsec,
+			   (unsigned int)(min - iter),
+			   (a->op == REG_TRACE_OP_READ) ? 'R' :
+			   (a->op == REG_TRACE_OP_WRITE) ? 'W' : '?',
+			   a->offset, a->value, a->e);
+
+		if (!_records_iter_next(min))
+			min->ring = NULL;
+	}
+	kfree(iter);
+
+unlock:
+	mutex_unlock(&t->ctl);
+	return 0;
+}
+
+static int
+_records_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, _records_show, inode->i_private);
+}
+
+/* Any write clears the records. */
+static ssize_t
+_records_write(struct file *file, const char __user *buf,
+	       size_t count, loff_t *ppos)
+{
+	struct reg_trace_dev *t = ((struct seq_file *)file->private_data)->private;
+
+	mutex_lock(&t->ctl);
+	if (t->rings)
+		_reg_trace_rings_reset(t);
+	mutex_unlock(&t->ctl);
+	return count;
+}
+
+static const struct file_operations _records_fops = {
+	.owner = THIS_MODULE,
+	.open = _records_open,
+	.read = seq_read,
+	.write = _records_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/*
+ * Binary stream of the rings; see reg_trace.h for the layout.  The
+ * extent of each ring is fixed at open, and reads copy straight from the
+ * ring to the caller.  A reset or re-enable after open makes further
+ * reads fail with -ESTALE.
+ */
+struct _stream {
+	struct reg_trace_dev *t;
+	u32 gen;
+	struct reg_trace_cpu_hdr_t cpu[];
+};
+
+#define _HDR_SIZE sizeof(struct reg_trace_cpu_hdr_t)
+
+static int
+_stream_open(struct inode *inode, struct file *file)
+{
+	struct reg_trace_dev *t = inode->i_private;
+	struct _stream *st;
+	unsigned int cpu;
+
+	st = kzalloc(struct_size(st, cpu, nr_cpu_ids), GFP_KERNEL);
+	if (!st)
+		return -ENOMEM;
+
+	st->t = t;
+	mutex_lock(&t->ctl);
+	st->gen = t->gen;
+	for_each_possible_cpu(cpu) {
+		st->cpu[cpu].op = REG_TRACE_OP_CPU;
+		st->cpu[cpu].cpu = cpu;
+	}
+	if (t->rings && _reg_trace_rings_sync(t)) {
+		for_each_possible_cpu(cpu) {
+			const struct reg_trace_ring_t *ring = per_cpu_ptr(t->rings, cpu);
+
+			st->cpu[cpu].len = smp_load_acquire(&ring->head);
+			st->cpu[cpu].tail = READ_ONCE(ring->tail);
+			st->cpu[cpu].len -= st->cpu[cpu].tail;
+			st->cpu[cpu].dropped = READ_ONCE(ring->dropped);
+		}
+	}
+	mutex_unlock(&t->ctl);
+
+	file->private_data = st;
+	return nonseekable_open(inode, file);
+}
+
+static ssize_t
+_stream_read_cpu(struct _stream *st, unsigned int cpu,
+		 loff_t off, struct iov_iter *to)
+{
+	const struct reg_trace_ring_t *ring = per_cpu_ptr(st->t->rings, cpu);
+	const struct reg_trace_cpu_hdr_t *hdr = &st->cpu[cpu];
+	u32 idx;
+	size_t len;
+
+	if (off < _HDR_SIZE)
+		return copy_to_iter((const u8 *)hdr + off, _HDR_SIZE - off, to);
+
+	/* up to the end of the ring or of this CPU's records */
+	off -= _HDR_SIZE;
+	idx = (hdr->tail + off) & ring->mask;
+	len = min_t(size_t, ring->mask + 1 - idx, hdr->len - off);
+	return copy_to_iter(&ring->buf[idx], len, to);
+}
+
+static ssize_t
+_stream_read_iter(struct kiocb *iocb, struct iov_iter *to)
+{
+	struct file *file = iocb->ki_filp;
+	struct _stream *st = file->private_data;
+	struct reg_trace_dev *t = st->t;
+	ssize_t n, copied = 0;
+	unsigned int cpu;
+	loff_t off, section;
+	int e;
+
+	e = debugfs_file_get(file->f_path.dentry);
+	if (e)
+		return e;
+
+	mutex_lock(&t->ctl);
+	if (st->gen != t->gen) {
+		copied = -ESTALE;
+		goto unlock;
+	}
+	if (!t->rings)
+		goto unlock;
+
+	off = iocb->ki_pos;
+	for_each_possible_cpu(cpu) {
+		section = _HDR_SIZE + st->cpu[cpu].len;
+		while (iov_iter_count(to) && (off < section)) {
+			n = _stream_read_cpu(st, cpu, off, to);
+			if (!n) {
+				if (!copied)
+					copied = -EFAULT;
+				goto unlock;
+			}
+			off += n;
+			copied += n;
+		}
+		if (!iov_iter_count(to))
+			break;
+		off -= section;
+	}
+	iocb->ki_pos += copied;
+
+unlock:
+	mutex_unlock(&t->ctl);
+	debugfs_file_put(file->f_path.dentry);
+	return copied;
+}
+
+static int
+_stream_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct _stream *st = file->private_data;
+	struct reg_trace_dev *t = st->t;
+	unsigned long ring_pages;
+	unsigned int cpu;
+	int e;
+
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+	vma->vm_flags &= ~VM_MAYWRITE;
+
+	e = debugfs_file_get(file->f_path.dentry);
+	if (e)
+		return e;
+
+	mutex_lock(&t->ctl);
+	if (!t->rings) {
+		e = -ENODATA;
+		goto unlock;
+	}
+	ring_pages = PAGE_ALIGN((size_t)raw_cpu_ptr(t->rings)->mask + 1) >> PAGE_SHIFT;
+	cpu = vma->vm_pgoff / ring_pages;
+	if ((cpu >= nr_cpu_ids) || !cpu_possible(cpu)) {
+		e = -EINVAL;
+		goto unlock;
+	}
+	/* the pages hold a reference, so the mapping outlives a re-enable */
+	e = remap_vmalloc_range(vma, per_cpu_ptr(t->rings, cpu)->buf,
+				vma->vm_pgoff % ring_pages);
+
+unlock:
+	mutex_unlock(&t->ctl);
+	debugfs_file_put(file->f_path.dentry);
+	return e;
+}
+
+static int
+_stream_release(struct inode *inode, struct file *file)
+{
+	kfree(file->private_data);
+	return 0;
+}
+
+static const struct file_operations _stream_fops = {
+	.owner = THIS_MODULE,
+	.open = _stream_open,
+	.read_iter = _stream_read_iter,
+	.splice_read = generic_file_splice_read,
+	.mmap = _stream_mmap,
+	.llseek = no_llseek,
+	.release = _stream_release,
+};
+
+static int
+_stats_show(struct seq_file *m, void *v)
+{
+	struct reg_trace_dev *t = m->private;
+	u64 dropped = 0;
+	u32 used = 0, count = 0;
+	unsigned int cpu;
+
+	mutex_lock(&t->ctl);
+	if (t->rings) {
+		for_each_possible_cpu(cpu) {
+			const struct reg_trace_ring_t *ring = per_cpu_ptr(t->rings, cpu);
+
+			used += reg_trace_ring_used(ring);
+			count += READ_ONCE(ring->count);
+			dropped += READ_ONCE(ring->dropped);
+		}
+	}
+	seq_printf(m, "enabled %u\nstate %s\nrecords %u\nbytes %u\ndropped %llu\n",
+		   t->enabled, _reg_trace_state_names[READ_ONCE(t->state)],
+		   count, used, dropped);
+	mutex_unlock(&t->ctl);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(_stats);
+
+static void
+_reg_trace_release(void *data)
+{
+	struct reg_trace_dev *t = data;
+
+	/* waits for open files to finish with t */
+	debugfs_remove_recursive(t->dir);
+	_reg_trace_enable(t, false);
+	_reg_trace_rings_free(t);
+	mutex_destroy(&t->ctl);
+	kfree(t);
+}
+
+int
+reg_trace_debugfs_init(struct device *dev, uintptr_t base)
+{
+	struct dentry *parent = cisco_fpga_debugfs_dir(dev);
+	struct reg_trace_dev *t;
+
+	if (IS_ERR_OR_NULL(parent))
+		return parent ? PTR_ERR(parent) : -ENODEV;
+
+	t = kzalloc(sizeof(*t), GFP_KERNEL);
+	if (!t)
+		return -ENOMEM;
+
+	t->dev = dev;
+	t->base = base;
+	t->size = REG_TRACE_DEFAULT_SIZE;
+	t->cfg.filter_hi = U32_MAX;
+	t->cfg.filter_ops = BIT(REG_TRACE_OP_READ) | BIT(REG_TRACE_OP_WRITE);
+	t->cfg.start_offset = REG_TRACE_NO_TRIGGER;
+	t->cfg.start_mask = U32_MAX;
+	t->cfg.stop_offset = REG_TRACE_NO_TRIGGER;
+	t->state = REG_TRACE_STATE_RUNNING;
+	mutex_init(&t->ctl);
+	INIT_LIST_HEAD(&t->node);
+
+	t->dir = debugfs_create_dir("reg_trace", parent);
+	debugfs_create_file_unsafe("enable", 0600, t->dir, t, &_enable_fops);
+	debugfs_create_u32("size", 0600, t->dir, &t->size);
+	debugfs_create_file("records", 0600, t->dir, t, &_records_fops);
+	debugfs_create_file("stats", 0400, t->dir, t, &_stats_fops);
+	/* unsafe: the proxy does not pass read_iter, splice or mmap through */
+	debugfs_create_file_unsafe("stream", 0400, t->dir, t, &_stream_fops);
+
+	debugfs_create_x32("filter_lo", 0600, t->dir, &t->cfg.filter_lo);
+	debugfs_create_x32("filter_hi", 0600, t->dir, &t->cfg.filter_hi);
+	debugfs_create_x32("filter_ops", 0600, t->dir, &t->cfg.filter_ops);
+	debugfs_create_x32("start_offset", 0600, t->dir, &t->cfg.start_offset);
+	debugfs_create_x32("start_value", 0600, t->dir, &t->cfg.start_value);
+	debugfs_create_x32("start_mask", 0600, t->dir, &t->cfg.start_mask);
+	debugfs_create_x32("stop_offset", 0600, t->dir, &t->cfg.stop_offset);
+	debugfs_create_x32("stop_mask", 0600, t->dir, &t->cfg.stop_mask);
+	debugfs_create_u32("pre", 0600, t->dir, &t->cfg.pre);
+	debugfs_create_u32("post", 0600, t->dir, &t->cfg.post);
+
+	return devm_add_action_or_reset(dev, _reg_trace_release, t);
+}
+EXPORT_SYMBOL(reg_trace_debugfs_init);
@@ -10,9 +10,11 @@
 #define _CISCO_REG_TRACE_H
 
 #include <linux/compiler.h>
+#include <linux/kernel.h>
 #include <linux/types.h>
 #include <linux/timekeeping.h>
 #include <linux/slab.h>
+#include <linux/jump_label.h>
 
 struct device;
 
@@ -26,6 +28,8 @@ enum reg_trace_op_t {
 	REG_TRACE_OP_DATA,
 	REG_TRACE_OP_READ,
 	REG_TRACE_OP_WRITE,
+	REG_TRACE_OP_TIME,
+	REG_TRACE_OP_CPU,
 	REG_TRACE_OP_NEXT,
 };
 
@@ -50,11 +54,129 @@ struct reg_trace_t {
 	size_t write_tail;
 
 	bool   overflow;
+	bool   overwrite;	/* drop the oldest records instead */
 	size_t max_size;
 
-	struct timespec64 walk_ts;
+	uint64_t last_ns;
+	uint64_t walk_ns;
 };
 
+/*
+ * Compact encoding.
+ *
+ * Integers are LEB128 varints.  A reg_trace_t record header is an op
+ * byte, the nanoseconds since the previous record and the payload length.
+ * A per-CPU ring record (below) is a tag byte holding the op and
+ * REG_TRACE_F_ERR, the nanoseconds since the previous record (or the
+ * absolute time for REG_TRACE_OP_TIME, which has nothing else), the
+ * register offset from the block's csr base, the value and, only when
+ * REG_TRACE_F_ERR is set, the zigzag encoded errno.  A typical access
+ * takes 6 to 10 bytes.
+ */
+#define REG_TRACE_VARINT_MAX	10
+#define REG_TRACE_HDR_MAX	(1 + 2 * REG_TRACE_VARINT_MAX)
+#define REG_TRACE_REC_MAX	(1 + REG_TRACE_VARINT_MAX + 3 * 5)
+#define REG_TRACE_TIME_MAX	(1 + REG_TRACE_VARINT_MAX)
+
+#define REG_TRACE_OP_MASK	0x0f
+#define REG_TRACE_F_ERR		0x10
+
+/* A decoded ring record */
+struct reg_trace_access_t {
+	uint64_t delta;		/* absolute time for REG_TRACE_OP_TIME */
+	uint32_t offset;
+	uint32_t value;
+	uint16_t op;
+	int      e;
+};
+
+static inline size_t
+reg_trace_varint_put(uint8_t *p, uint64_t v)
+{
+	size_t n = 0;
+
+	for (; v >= 0x80; v >>= 7)
+		p[n++] = (uint8_t)v | 0x80;
+	p[n++] = (uint8_t)v;
+	return n;
+}
+
+/* Returns the bytes used, or 0 if p[0..len) does not hold a varint */
+static inline size_t
+reg_trace_varint_get(const uint8_t *p, size_t len, uint64_t *v)
+{
+	uint64_t r = 0;
+	size_t n;
+
+	for (n = 0; (n < len) && (n < REG_TRACE_VARINT_MAX); ++n) {
+		r |= (uint64_t)(p[n] & 0x7f) << (7 * n);
+		if (!(p[n] & 0x80)) {
+			*v = r;
+			return n + 1;
+		}
+	}
+	return 0;
+}
+
+static inline size_t
+reg_trace_encode(uint8_t *p, const struct reg_trace_access_t *a)
+{
+	size_t n = 1;
+
+	p[0] = a->op & REG_TRACE_OP_MASK;
+	n += reg_trace_varint_put(&p[n], a->delta);
+	if (a->op == REG_TRACE_OP_TIME)
+		return n;
+	n += reg_trace_varint_put(&p[n], a->offset);
+	n += reg_trace_varint_put(&p[n], a->value);
+	if (a->e) {
+		p[0] |= REG_TRACE_F_ERR;
+		n += reg_trace_varint_put(&p[n], ((uint32_t)a->e << 1) ^ (uint32_t)(a->e >> 31));
+	}
+	return n;
+}
+
+/* Returns the bytes used, or 0 if p[0..len) does not hold a record */
+static inline size_t
+reg_trace_decode(const uint8_t *p, size_t len, struct reg_trace_access_t *a)
+{
+	uint64_t v;
+	size_t n = 1, k;
+
+	if (!len)
+		return 0;
+	memset(a, 0, sizeof(*a));
+	a->op = p[0] & REG_TRACE_OP_MASK;
+
+	k = reg_trace_varint_get(&p[n], len - n, &a->delta);
+	if (!k)
+		return 0;
+	n += k;
+	if (a->op == REG_TRACE_OP_TIME)
+		return n;
+
+	k = reg_trace_varint_get(&p[n], len - n, &v);
+	if (!k)
+		return 0;
+	a->offset = v;
+	n += k;
+
+	k = reg_trace_varint_get(&p[n], len - n, &v);
+	if (!k)
+		return 0;
+	a->value = v;
+	n += k;
+
+	if (p[0] & REG_TRACE_F_ERR) {
+		k = reg_trace_varint_get(&p[n], len - n, &v);
+		if (!k)
+			return 0;
+		a->e = (int)((uint32_t)v >> 1) ^ -(int)(v & 1);
+		n += k;
+	}
+	return n;
+}
+
 static inline int
 reg_trace_init(struct reg_trace_t *tracep, size_t size)
 {
@@ -132,7 +254,9 @@ _reg_trace_fill(struct reg_trace_t *tracep,
 static inline void
 _reg_trace_read_skip(struct reg_trace_t *tracep, size_t len)
 {
-	tracep->read_head = (tracep->read_head + len) % tracep->size;
+	tracep->read_head += len;
+	if (tracep->read_head >= tracep->size)
+		tracep->read_head -= tracep->size;
 }
 
 
@@ -152,21 +276,35 @@ _reg_trace_write(struct reg_trace_t *tracep,
 	}
 }
 
+extern bool reg_trace_drop_oldest(struct reg_trace_t *tracep);
+
 static inline void
 reg_trace(struct reg_trace_t *tracep,
 	  uint16_t op,
 	  const void *data,
 	  size_t data_len)
 {
-	struct reg_trace_hdr_t hdr;
+	uint8_t hdr[REG_TRACE_HDR_MAX];
+	uint64_t now = ktime_get_real_ns();
+	size_t n = 1;
+
+	hdr[0] = op;
+	n += reg_trace_varint_put(&hdr[n], now - tracep->last_ns);
+	n += reg_trace_varint_put(&hdr[n], data_len);
 
-	if ((sizeof(hdr) + data_len) > _reg_trace_write_space(tracep)) {
+	if ((data_len > U16_MAX) || ((n + data_len) >= tracep->size)) {
+		tracep->overflow = 1;
+		return;
+	}
+	while (tracep->overwrite
+	       && ((n + data_len) > _reg_trace_write_space(tracep))
+	       && reg_trace_drop_oldest(tracep))
+		;
+	if ((n + data_len) > _reg_trace_write_space(tracep)) {
 		tracep->overflow = 1;
 	} else {
-		ktime_get_real_ts64(&hdr.ts);
-		hdr.op = op;
-		hdr.len = data_len;
-		_reg_trace_write(tracep, &hdr, sizeof(hdr));
+		tracep->last_ns = now;
+		_reg_trace_write(tracep, hdr, n);
 		_reg_trace_write(tracep, data, data_len);
 	}
 }
@@ -181,8 +319,8 @@ reg_trace_reset(struct reg_trace_t *tracep)
 
 	tracep->read_head = tracep->write_tail = 0;
 	tracep->overflow = 0;
-	tracep->walk_ts.tv_sec = 0;
-	tracep->walk_ts.tv_nsec = 0;
+	tracep->last_ns = 0;
+	tracep->walk_ns = 0;
 }
 
 typedef void (*reg_trace_walk_fn_t)(struct reg_trace_t *tracep,
@@ -198,4 +336,203 @@ extern void reg_trace_display_buffer(struct device *dev,
 				     const uint8_t *datap,
 				     size_t count);
 
+/*
+ * Per-CPU register access ring.
+ *
+ * Each ring is a power of two bytes of compact records (see above), so
+ * positions are found by masking free running byte indices.  A ring is
+ * only ever written by its own CPU, with local interrupts disabled while
+ * a record is stored, so process and IRQ context accesses cannot
+ * interleave and no lock is taken.  head is published with release
+ * semantics; records in [tail, head) are complete and are not rewritten
+ * until the ring is reset.  When the ring is full new records are dropped
+ * and counted.
+ *
+ * While a start trigger is armed the ring instead overwrites its oldest
+ * records, keeping in base_ns the time they leave behind.  Once the
+ * trigger fires reg_trace_ring_keep() trims the ring to the pre-trigger
+ * depth and puts a time record back at its start.
+ *
+ * Timestamps are ktime_get_mono_fast_ns() deltas from the previous record
+ * on the same CPU.  A REG_TRACE_OP_TIME record carrying the absolute time
+ * starts every non-empty ring.
+ *
+ * The debugfs stream file returns, for each possible CPU, a struct
+ * reg_trace_cpu_hdr_t followed by len bytes of that CPU's records exactly
+ * as they are laid out in the ring.  tools/cisco has a decoder.  Rings
+ * can also be mapped read-only from the same file, one page-aligned ring
+ * per CPU in CPU order.
+ */
+struct reg_trace_cpu_hdr_t {
+	uint16_t op;		/* REG_TRACE_OP_CPU */
+	uint16_t reserved;
+	uint32_t cpu;
+	uint32_t len;
+	uint32_t tail;
+	uint64_t dropped;
+};
+
+struct reg_trace_ring_t {
+	uint8_t  *buf;
+	uint32_t mask;
+	uint32_t head;
+	uint32_t tail;
+	uint32_t count;
+	uint64_t last_ns;
+	uint64_t base_ns;
+	uint64_t dropped;
+	bool     armed;
+};
+
+static inline uint32_t
+reg_trace_ring_used(const struct reg_trace_ring_t *ringp)
+{
+	return smp_load_acquire(&ringp->head) - READ_ONCE(ringp->tail);
+}
+
+/* Copy out up to REG_TRACE_REC_MAX bytes from idx, stopping at end */
+static inline size_t
+reg_trace_ring_peek(const struct reg_trace_ring_t *ringp,
+		    uint32_t idx, uint32_t end, uint8_t *dst)
+{
+	size_t len = min_t(size_t, end - idx, REG_TRACE_REC_MAX);
+	uint32_t off = idx & ringp->mask;
+	size_t n = min_t(size_t, len, ringp->mask + 1 - off);
+
+	memcpy(dst, &ringp->buf[off], n);
+	memcpy(dst + n, ringp->buf, len - n);
+	return len;
+}
+
+static inline void
+_reg_trace_ring_store(struct reg_trace_ring_t *ringp, uint32_t idx,
+		      const uint8_t *src, size_t len)
+{
+	uint32_t off = idx & ringp->mask;
+	size_t n = min_t(size_t, len, ringp->mask + 1 - off);
+
+	memcpy(&ringp->buf[off], src, n);
+	memcpy(ringp->buf, src + n, len - n);
+}
+
+/* Drop the oldest record, keeping track of the time it leaves behind. */
+static inline void
+_reg_trace_ring_evict(struct reg_trace_ring_t *ringp)
+{
+	uint8_t buf[REG_TRACE_REC_MAX];
+	struct reg_trace_access_t a;
+	size_t len;
+
+	len = reg_trace_ring_peek(ringp, ringp->tail, ringp->head, buf);
+	len = reg_trace_decode(buf, len, &a);
+	if (!len) {
+		/* cannot happen; start over rather than loop */
+		WRITE_ONCE(ringp->tail, ringp->head);
+		ringp->count = 0;
+		return;
+	}
+	if (a.op == REG_TRACE_OP_TIME) {
+		ringp->base_ns = a.delta;
+	} else {
+		ringp->base_ns += a.delta;
+		ringp->count--;
+	}
+	WRITE_ONCE(ringp->tail, ringp->tail + len);
+}
+
+/*
+ * Called on the ring's own CPU with local interrupts disabled once the
+ * start trigger has fired; keeps the newest pre records.
+ */
+static inline void
+reg_trace_ring_keep(struct reg_trace_ring_t *ringp, uint32_t pre)
+{
+	uint8_t buf[REG_TRACE_REC_MAX];
+	struct reg_trace_access_t a = { .op = REG_TRACE_OP_TIME };
+	size_t len;
+
+	/* leave room for the time record */
+	while ((ringp->count > pre) ||
+	       ((ringp->head - ringp->tail) > (ringp->mask + 1 - REG_TRACE_TIME_MAX)))
+		_reg_trace_ring_evict(ringp);
+
+	if (ringp->head != ringp->tail) {
+		len = reg_trace_ring_peek(ringp, ringp->tail, ringp->head, buf);
+		if ((buf[0] & REG_TRACE_OP_MASK) != REG_TRACE_OP_TIME) {
+			a.delta = ringp->base_ns;
+			len = reg_trace_encode(buf, &a);
+			_reg_trace_ring_store(ringp, ringp->tail - len, buf, len);
+			WRITE_ONCE(ringp->tail, ringp->tail - len);
+		}
+	}
+	ringp->armed = false;
+}
+
+/* Called on the ring's own CPU with local interrupts disabled. */
+static inline void
+reg_trace_ring_put(struct reg_trace_ring_t *ringp, uint16_t op,
+		   uint32_t offset, uint32_t value, int e)
+{
+	uint64_t now = ktime_get_mono_fast_ns();
+	uint8_t rec[REG_TRACE_TIME_MAX + REG_TRACE_REC_MAX];
+	struct reg_trace_access_t a = {
+		.delta = now - ringp->last_ns,
+		.offset = offset,
+		.value = value,
+		.op = op,
+		.e = e,
+	};
+	struct reg_trace_access_t ts = {
+		.delta = now,
+		.op = REG_TRACE_OP_TIME,
+	};
+	uint32_t head = ringp->head;
+	size_t len = 0;
+
+	if (head == ringp->tail) {
+		len = reg_trace_encode(rec, &ts);
+		a.delta = 0;
+	}
+	len += reg_trace_encode(&rec[len], &a);
+
+	if ((head - ringp->tail + len) > (ringp->mask + 1)) {
+		if (!ringp->armed) {
+			ringp->dropped++;
+			return;
+		}
+		while ((head != ringp->tail) &&
+		       ((head - ringp->tail + len) > (ringp->mask + 1)))
+			_reg_trace_ring_evict(ringp);
+	}
+
+	_reg_trace_ring_store(ringp, head, rec, len);
+	ringp->count++;
+	ringp->last_ns = now;
+	smp_store_release(&ringp->head, head + len);
+}
+
+/*
+ * Runtime register access tracing.
+ *
+ * Accessors call reg_trace_access() after each register access.  It is a
+ * patched-out branch until tracing is enabled for at least one block
+ * through debugfs (cisco-fpga/<device>/reg_trace/enable); only accesses
+ * made on behalf of an enabled block are recorded.
+ */
+DECLARE_STATIC_KEY_FALSE(reg_trace_key);
+
+extern void __reg_trace_access(const struct device *dev, uint16_t op,
+			       const void __iomem *addr, uint32_t value,
+			       int e);
+
+static inline void
+reg_trace_access(const struct device *dev, uint16_t op,
+		 const void __iomem *addr, uint32_t value, int e)
+{
+	if (static_branch_unlikely(&reg_trace_key))
+		__reg_trace_access(dev, op, addr, value, e);
+}
+
+extern int reg_trace_debugfs_init(struct device *dev, uintptr_t base);
+
 #endif /* ndef _CISCO_REG_TRACE_H */
@@ -10,7 +10,10 @@
 
 #include <linux/platform_device.h>
 
+struct regmap;
+
 #define SYSFS_MAX_DATA  (2)
+#define SYSFS_MAX_DATA_N  (16)
 
 struct sysfs_ext_attribute;
 typedef ssize_t (sysfs_ext_attribute_fmt_fn_t)(
@@ -53,6 +56,15 @@ struct sysfs_ext_attribute {
 	size_t store_table_dim;
 	u32 reg[SYSFS_MAX_DATA];
 	u32 mask[SYSFS_MAX_DATA];
+
+	/*
+	 * Attributes of up to SYSFS_MAX_DATA_N registers list them here
+	 * instead of in reg[] and mask[].  masks may be NULL for read-only
+	 * attributes.
+	 */
+	const u32 *regs;
+	const u32 *masks;
+	size_t nregs;
 };
 extern ssize_t
 cisco_fpga_sysfs_show(struct device *dev, struct device_attribute *dattr,
@@ -64,6 +76,22 @@ extern ssize_t
 cisco_fpga_sysfs_store_table(struct device *dev, struct device_attribute *dattr,
 			     const char *buf, size_t buflen);
 
+/*
+ * Register reads for custom show routines, served from the block's
+ * sysfs cache when it has a lifetime (see info/sysfs_cache).
+ */
+extern int
+cisco_fpga_sysfs_read(struct device *dev, struct regmap *r,
+		      const u32 *regs, u32 *data, size_t dim);
+extern void
+cisco_fpga_sysfs_cache_invalidate(struct device *dev);
+extern ssize_t
+cisco_fpga_sysfs_cache_show(struct device *dev, struct device_attribute *attr,
+			    char *buf);
+extern ssize_t
+cisco_fpga_sysfs_cache_store(struct device *dev, struct device_attribute *attr,
+			     const char *buf, size_t buflen);
+
 #define CISCO_ATTR_U32_RW_F(_name, _f, _reg, _m) \
 	struct sysfs_ext_attribute cisco_attr_##_name = { \
 		.attr = __ATTR(_name, 0644, cisco_fpga_sysfs_show, cisco_fpga_sysfs_store), \
@@ -197,6 +225,35 @@ cisco_fpga_sysfs_store_table(struct device *dev, struct device_attribute *dattr,
 			 _reg0, CISCO_SYSFS_U32_MASK, \
 			 _reg1, CISCO_SYSFS_U32_MASK)
 
+/*
+ * Generic r/w access of up to SYSFS_MAX_DATA_N registers.
+ * _regs (and _masks) are arrays of register offsets (and field masks).
+ * input/output is user supplied.
+ */
+#define CISCO_ATTR_RW_N_F(_name, _f, _regs, _masks) \
+	struct sysfs_ext_attribute cisco_attr_##_name = { \
+		.attr = __ATTR(_name, 0644, cisco_fpga_sysfs_show, cisco_fpga_sysfs_store), \
+		.regs = (_regs), \
+		.masks = (_masks), \
+		.nregs = ARRAY_SIZE(_regs), \
+		.flags = (_f), \
+		.fmt_fn = _ ## _name ## _fmt, \
+		.parse_fn = _ ## _name ## _parse, \
+	}
+#define CISCO_ATTR_RO_N_F(_name, _f, _regs) \
+	struct sysfs_ext_attribute cisco_attr_##_name = { \
+		.attr = __ATTR(_name, 0444, cisco_fpga_sysfs_show, NULL), \
+		.regs = (_regs), \
+		.nregs = ARRAY_SIZE(_regs), \
+		.flags = (_f), \
+		.fmt_fn = _ ## _name ## _fmt, \
+	}
+
+#define CISCO_ATTR_RO_N(_name, _regs) \
+	CISCO_ATTR_RO_N_F(_name, 0, _regs)
+#define CISCO_ATTR_RW_N(_name, _regs, _masks) \
+	CISCO_ATTR_RW_N_F(_name, 0, _regs, _masks)
+
 /*
  * Generic r/w access of a single register.
  * input is table based.
@@ -7,9 +7,14 @@
  */
 #include <linux/module.h>
 #include <linux/moduleparam.h>
+#include <linux/device.h>
+#include <linux/debugfs.h>
+#include <linux/sysfs.h>
 #include <linux/regmap.h>
 #include <regmap/internal.h>
 
+#include <cisco/mfd.h>
+#include <cisco/sysfs.h>
 #include <cisco/util.h>
 
 #define DRIVER_VERSION "1.0"
@@ -24,6 +29,279 @@ cisco_regmap_set_max_register(struct device *dev, unsigned int max_reg)
 }
 EXPORT_SYMBOL(cisco_regmap_set_max_register);
 
+/*
+ * Access under the regmap lock held by the caller.  These go straight to
+ * the regmap's register callbacks, bypassing its cache.  A write drops
+ * the register from the cache before the lock is released, so that no
+ * other user of the regmap reads back the value it replaced.
+ */
+void
+cisco_regmap_lock(struct regmap *r)
+{
+	r->lock(r->lock_arg);
+}
+EXPORT_SYMBOL(cisco_regmap_lock);
+
+void
+cisco_regmap_unlock(struct regmap *r)
+{
+	r->unlock(r->lock_arg);
+}
+EXPORT_SYMBOL(cisco_regmap_unlock);
+
+static void *
+_regmap_context(struct regmap *r)
+{
+	return r->bus ? r : r->bus_context;
+}
+
+int
+cisco_regmap_read_locked(struct regmap *r, unsigned int reg, unsigned int *val)
+{
+	if (!r->reg_read)
+		return -EOPNOTSUPP;
+	return r->reg_read(_regmap_context(r), reg, val);
+}
+EXPORT_SYMBOL(cisco_regmap_read_locked);
+
+int
+cisco_regmap_write_locked(struct regmap *r, unsigned int reg, unsigned int val)
+{
+	int e;
+
+	if (!r->reg_write)
+		return -EOPNOTSUPP;
+	/* a cache that cannot drop a register would go stale */
+	if (r->cache_ops && !r->cache_ops->drop)
+		return -EOPNOTSUPP;
+	e = r->reg_write(_regmap_context(r), reg, val);
+	if (r->cache_ops)
+		r->cache_ops->drop(r, reg, reg);
+	return e;
+}
+EXPORT_SYMBOL(cisco_regmap_write_locked);
+
+/*
+ * 64-bit values split over a high and a low register.  The locked
+ * forms keep other users of the regmap from interleaving; they cannot
+ * stop another bus master, such as the BMC, from doing so.
+ */
+int
+cisco_regmap_read_u64(struct regmap *r, u32 hi, u32 lo, u64 *dst)
+{
+	unsigned int v[2];
+	int e;
+
+	cisco_regmap_lock(r);
+	e = cisco_regmap_read_locked(r, hi, &v[0]);
+	if (!e)
+		e = cisco_regmap_read_locked(r, lo, &v[1]);
+	cisco_regmap_unlock(r);
+	if (!e)
+		*dst = ((u64)v[0] << 32) | v[1];
+	return e;
+}
+EXPORT_SYMBOL(cisco_regmap_read_u64);
+
+int
+cisco_regmap_write_u64(struct regmap *r, u32 hi, u32 lo, u64 src)
+{
+	int e;
+
+	cisco_regmap_lock(r);
+	e = cisco_regmap_write_locked(r, hi, src >> 32);
+	if (!e)
+		e = cisco_regmap_write_locked(r, lo, (u32)src);
+	cisco_regmap_unlock(r);
+	cisco_fpga_sysfs_cache_invalidate(regmap_get_device(r));
+	return e;
+}
+EXPORT_SYMBOL(cisco_regmap_write_u64);
+
+/*
+ * value = ((value & and_val) ^ xor_val) | or_val
+ */
+int
+cisco_regmap_update_u64(struct regmap *r, u32 hi, u32 lo,
+			u64 and_val, u64 xor_val, u64 or_val, u64 *result)
+{
+	unsigned int v[2];
+	u64 value = 0;
+	int e;
+
+	cisco_regmap_lock(r);
+	e = cisco_regmap_read_locked(r, hi, &v[0]);
+	if (!e)
+		e = cisco_regmap_read_locked(r, lo, &v[1]);
+	if (!e) {
+		value = ((u64)v[0] << 32) | v[1];
+		value = ((value & and_val) ^ xor_val) | or_val;
+		e = cisco_regmap_write_locked(r, hi, value >> 32);
+		if (!e)
+			e = cisco_regmap_write_locked(r, lo, (u32)value);
+	}
+	cisco_regmap_unlock(r);
+	cisco_fpga_sysfs_cache_invalidate(regmap_get_device(r));
+	if (!e && result)
+		*result = value;
+	return e;
+}
+EXPORT_SYMBOL(cisco_regmap_update_u64);
+
+/*
+ * Counters that carry from lo into hi: read hi, lo, hi and retry until
+ * hi is stable.  Holds the regmap lock only for each single access.
+ */
+#define CISCO_REGMAP_U64_RETRIES 4
+
+int
+cisco_regmap_read_u64_consistent(struct regmap *r, u32 hi, u32 lo, u64 *dst)
+{
+	unsigned int h0, h1, l;
+	int retry;
+	int e;
+
+	e = regmap_read(r, hi, &h0);
+	for (retry = 0; !e && (retry < CISCO_REGMAP_U64_RETRIES); ++retry) {
+		e = regmap_read(r, lo, &l);
+		if (!e)
+			e = regmap_read(r, hi, &h1);
+		if (!e && (h0 == h1)) {
+			*dst = ((u64)h1 << 32) | l;
+			return 0;
+		}
+		h0 = h1;
+	}
+	return e ? e : -EAGAIN;
+}
+EXPORT_SYMBOL(cisco_regmap_read_u64_consistent);
+
+static bool
+_regmap_precious(struct regmap *r, unsigned int reg)
+{
+	if (r->precious_reg)
+		return r->precious_reg(r->dev, reg);
+	if (r->precious_table)
+		return regmap_check_range_table(r, reg, r->precious_table);
+	return false;
+}
+
+/*
+ * sysfs file regs: binary snapshot of the block's register window.
+ * Each run of registers between precious registers is one bulk read;
+ * precious registers read back as zero.
+ */
+static ssize_t
+regs_read(struct file *filp, struct kobject *kobj,
+	  struct bin_attribute *attr,
+	  char *buf, loff_t off, size_t count)
+{
+	struct device *dev = kobj_to_dev(kobj);
+	struct regmap *r = dev_get_regmap(dev, NULL);
+	u32 *data = (u32 *)buf;
+	unsigned int reg, start, end;
+	loff_t size;
+	int e;
+
+	if (!r)
+		return -ENXIO;
+	if ((off | count) & 3)
+		return -EINVAL;
+
+	e = regmap_get_max_register(r);
+	if (e < 0)
+		return e;
+	size = ((loff_t)e + 4) & ~3ll;
+	if (off >= size)
+		return 0;
+	count = min_t(loff_t, count, size - off);
+
+	end = off + count;
+	for (reg = off; reg < end; ) {
+		if (_regmap_precious(r, reg)) {
+			data[(reg - off) / 4] = 0;
+			reg += 4;
+			continue;
+		}
+		for (start = reg; (reg < end) && !_regmap_precious(r, reg); )
+			reg += 4;
+		e = regmap_bulk_read(r, start, &data[(start - off) / 4],
+				     (reg - start) / 4);
+		if (e)
+			return e;
+	}
+	return count;
+}
+static BIN_ATTR_RO(regs, 0);
+
+static void
+_regs_remove(void *data)
+{
+	struct device *dev = data;
+
+	sysfs_remove_bin_file(&dev->kobj, &bin_attr_regs);
+}
+
+int
+cisco_fpga_regs_sysfs_init(struct device *dev)
+{
+	int e = sysfs_create_bin_file(&dev->kobj, &bin_attr_regs);
+
+	if (!e)
+		e = devm_add_action_or_reset(dev, _regs_remove, dev);
+	return e;
+}
+EXPORT_SYMBOL(cisco_fpga_regs_sysfs_init);
+
+/*
+ * debugfs: /sys/kernel/debug/cisco-fpga/<device>/
+ */
+static struct dentry *cisco_debugfs_root;
+
+static void
+_debugfs_dir_release(struct device *dev, void *res)
+{
+	debugfs_remove_recursive(*(struct dentry **)res);
+}
+
+struct dentry *
+cisco_fpga_debugfs_dir(struct device *dev)
+{
+	struct dentry **dp = devres_find(dev, _debugfs_dir_release, NULL, NULL);
+
+	if (dp)
+		return *dp;
+
+	dp = devres_alloc(_debugfs_dir_release, sizeof(*dp), GFP_KERNEL);
+	if (!dp)
+		return ERR_PTR(-ENOMEM);
+	*dp = debugfs_create_dir(dev_name(dev), cisco_debugfs_root);
+	devres_add(dev, dp);
+	return *dp;
+}
+EXPORT_SYMBOL(cisco_fpga_debugfs_dir);
+
+static int __init
+cisco_util_init(void)
+{
+	cisco_debugfs_root = debugfs_create_dir("cisco-fpga", NULL);
+	cisco_fpga_mfd_blk_index_init();
+	if (cisco_fpga_mfd_probe_stats_init(cisco_debugfs_root))
+		pr_warn("cisco-fpga: probe statistics unavailable\n");
+	return 0;
+}
+
+static void __exit
+cisco_util_exit(void)
+{
+	cisco_fpga_mfd_probe_stats_exit();
+	cisco_fpga_mfd_topology_flush();
+	debugfs_remove_recursive(cisco_debugfs_root);
+}
+
+module_init(cisco_util_init);
+module_exit(cisco_util_exit);
+
 MODULE_LICENSE("GPL v2");
 MODULE_DESCRIPTION("Cisco Utilities");
 MODULE_AUTHOR("Cisco Systems, Inc. <ospo-kmod@cisco.com>");
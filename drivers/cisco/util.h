@@ -29,6 +29,7 @@ struct reboot_info {
 };
 
 struct device;
+struct dentry;
 struct attribute_group;
 struct platform_device;
 
@@ -49,6 +50,24 @@ extern int cisco_fpga_select_new_acpi_companion(struct device *dev, struct regma
 extern struct device *cisco_acpi_find_device_by_handle(acpi_handle h);
 
 extern void cisco_regmap_set_max_register(struct device *dev, unsigned int max_reg);
+extern int cisco_fpga_regs_sysfs_init(struct device *dev);
+
+extern void cisco_regmap_lock(struct regmap *r);
+extern void cisco_regmap_unlock(struct regmap *r);
+extern int cisco_regmap_read_locked(struct regmap *r, unsigned int reg,
+				    unsigned int *val);
+extern int cisco_regmap_write_locked(struct regmap *r, unsigned int reg,
+				     unsigned int val);
+
+extern int cisco_regmap_read_u64(struct regmap *r, u32 hi, u32 lo, u64 *dst);
+extern int cisco_regmap_write_u64(struct regmap *r, u32 hi, u32 lo, u64 src);
+extern int cisco_regmap_update_u64(struct regmap *r, u32 hi, u32 lo,
+				   u64 and_val, u64 xor_val, u64 or_val,
+				   u64 *result);
+extern int cisco_regmap_read_u64_consistent(struct regmap *r, u32 hi, u32 lo,
+					    u64 *dst);
+
+extern struct dentry *cisco_fpga_debugfs_dir(struct device *dev);
 
 #if KERNEL_VERSION(5, 19, 0) > LINUX_VERSION_CODE
 int acpi_dev_for_each_child(struct acpi_device *parent,
@@ -0,0 +1,182 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Decoder for the binary register trace stream
+ * (debugfs cisco-fpga/<device>/reg_trace/stream).
+ *
+ *   cc -O2 -o reg_trace_decode reg_trace_decode.c
+ *   reg_trace_decode < /sys/kernel/debug/cisco-fpga/<device>/reg_trace/stream
+ *
+ * Prints the same text as the records file: one line per access,
+ * merged across CPUs in time order.
+ *
+ * Copyright (c) 2022 by Cisco Systems, Inc.
+ * All rights reserved.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Must match drivers/cisco/reg_trace.h */
+struct reg_trace_cpu_hdr_t {
+	uint16_t op;
+	uint16_t reserved;
+	uint32_t cpu;
+	uint32_t len;
+	uint32_t tail;
+	uint64_t dropped;
+};
+
+_Static_assert(sizeof(struct reg_trace_cpu_hdr_t) == 24, "header size");
+
+enum reg_trace_op_t {
+	REG_TRACE_OP_DATA,
+	REG_TRACE_OP_READ,
+	REG_TRACE_OP_WRITE,
+	REG_TRACE_OP_TIME,
+	REG_TRACE_OP_CPU,
+};
+
+#define REG_TRACE_OP_MASK	0x0f
+#define REG_TRACE_F_ERR		0x10
+
+static size_t
+_varint(const uint8_t *p, size_t len, uint64_t *v)
+{
+	uint64_t r = 0;
+	size_t n;
+
+	for (n = 0; (n < len) && (n < 10); ++n) {
+		r |= (uint64_t)(p[n] & 0x7f) << (7 * n);
+		if (!(p[n] & 0x80)) {
+			*v = r;
+			return n + 1;
+		}
+	}
+	return 0;
+}
+
+struct access {
+	uint64_t ns;
+	size_t   seq;
+	uint64_t addr;		/* offset from the block's csr base */
+	uint32_t value;
+	uint32_t cpu;
+	uint16_t op;
+	int16_t  e;
+};
+
+static int
+_cmp(const void *a, const void *b)
+{
+	const struct access *x = a, *y = b;
+
+	if (x->ns != y->ns)
+		return (x->ns < y->ns) ? -1 : 1;
+	if (x->cpu != y->cpu)
+		return (x->cpu < y->cpu) ? -1 : 1;
+	/* keep each CPU's records in ring order */
+	return (x->seq < y->seq) ? -1 : (x->seq > y->seq);
+}
+
+int
+main(int argc, char *argv[])
+{
+	FILE *f = stdin;
+	struct reg_trace_cpu_hdr_t hdr;
+	struct access *v = NULL;
+	size_t n = 0, max = 0, i, k;
+	uint8_t *buf = NULL, *p, *end;
+	uint64_t ns, delta, x;
+
+	if ((argc > 1) && strcmp(argv[1], "-")) {
+		f = fopen(argv[1], "rb");
+		if (!f) {
+			fprintf(stderr, "%s: %s\n", argv[1], strerror(errno));
+			return 1;
+		}
+	}
+
+	while (fread(&hdr, sizeof(hdr), 1, f) == 1) {
+		if (hdr.op != REG_TRACE_OP_CPU) {
+			fprintf(stderr, "bad cpu header\n");
+			return 1;
+		}
+		if (hdr.dropped)
+			printf("# cpu %u dropped %" PRIu64 "\n", hdr.cpu, hdr.dropped);
+
+		buf = realloc(buf, hdr.len ? hdr.len : 1);
+		if (!buf || (fread(buf, 1, hdr.len, f) != hdr.len)) {
+			fprintf(stderr, "short read\n");
+			return 1;
+		}
+
+		ns = 0;
+		for (p = buf, end = buf + hdr.len; p < end; ) {
+			struct access a = { .cpu = hdr.cpu };
+
+			a.op = *p & REG_TRACE_OP_MASK;
+			k = 1;
+			k += i = _varint(p + k, end - p - k, &delta);
+			if (!i)
+				break;
+			if (a.op == REG_TRACE_OP_TIME) {
+				ns = delta;
+				p += k;
+				continue;
+			}
+			k += i = _varint(p + k, end - p - k, &x);
+			if (!i)
+				break;
+			a.addr = x;
+			k += i = _varint(p + k, end - p - k, &x);
+			if (!i)
+				break;
+			a.value = x;
+			if (*p & REG_TRACE_F_ERR) {
+				k += i = _varint(p + k, end - p - k, &x);
+				if (!i)
+					break;
+				a.e = (int)((uint32_t)x >> 1) ^ -(int)(x & 1);
+			}
+			p += k;
+
+			ns += delta;
+			a.ns = ns;
+			a.seq = n;
+			if (n == max) {
+				struct access *nv;
+
+				max = max ? (2 * max) : 4096;
+				nv = realloc(v, max * sizeof(*v));
+				if (!nv) {
+					fprintf(stderr, "out of memory\n");
+					return 1;
+				}
+				v = nv;
+			}
+			v[n++] = a;
+		}
+		if (p != end)
+			fprintf(stderr, "cpu %u: truncated record\n", hdr.cpu);
+	}
+	if (ferror(f)) {
+		fprintf(stderr, "read: %s\n", strerror(errno));
+		return 1;
+	}
+
+	qsort(v, n, sizeof(*v), _cmp);
+	for (i = 0; i < n; ++i)
+		printf("%" PRIu64 ".%09" PRIu64 " %u %c %#06" PRIx64 " %#010x %d\n",
+		       v[i].ns / 1000000000, v[i].ns % 1000000000, v[i].cpu,
+		       (v[i].op == REG_TRACE_OP_READ) ? 'R' :
+		       (v[i].op == REG_TRACE_OP_WRITE) ? 'W' : '?',
+		       v[i].addr, v[i].value, v[i].e);
+
+	free(buf);
+	free(v);
+	return 0;
+}